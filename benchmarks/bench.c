@@ -0,0 +1,417 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "renuke.h"
+
+// Synthetic workloads run through RN_Clock, reporting emulation speed for YM2612 and YM3438.
+// Usage: renuke-bench [-c] [-s seconds] [workload...], all workloads are run when none are given.
+// -c checks instead of timing: the fast engine has to match the cycle-accurate core sample for sample,
+// and the stems of every other chunk, clocked through RN_ClockStems, have to add up to the mix on both.
+
+#define CHUNK_SAMPLES 256          // Samples clocked (and dequeued) per RN_Clock call
+#define CHUNK_CLOCKS (CHUNK_SAMPLES * 24)
+#define WARMUP_CLOCKS (24 * 4096)  // Lets the scheduled setup writes land before timing starts
+#define DEFAULT_SECONDS 2          // Emulated seconds per workload and chip type
+
+typedef struct
+{
+    const char *name;
+    int param;
+    void (*setup)(RN_Chip *chip, int param);
+    void (*tick)(RN_Chip *chip, uint32_t chunk); // Called before every chunk, may be NULL
+} Workload;
+
+static const struct
+{
+    const char *name;
+    RN_ChipType type;
+} chip_types[] =
+{
+    { "ym2612", RNCM_YM2612 },
+    { "ym3438", 0 },
+    { "ym2612-fast", RNCM_YM2612 | RNCM_FAST },
+    { "ym3438-fast", RNCM_FAST },
+};
+
+static void write_register(RN_Chip *chip, uint32_t part, uint8_t reg, uint8_t data)
+{
+    RN_ScheduleWrite(chip, part, reg);
+    RN_ScheduleWrite(chip, part + 1, data);
+}
+
+static void write_channel(RN_Chip *chip, uint32_t ch, uint8_t reg, uint8_t data)
+{
+    write_register(chip, ch < 3 ? 0 : 2, reg + ch % 3, data);
+}
+
+static void write_operator(RN_Chip *chip, uint32_t ch, uint32_t op, uint8_t reg, uint8_t data)
+{
+    write_register(chip, ch < 3 ? 0 : 2, reg + op * 4 + ch % 3, data);
+}
+
+static uint8_t key_on_value(uint32_t ch, uint8_t slots)
+{
+    return (slots << 4) | (ch < 3 ? ch : ch + 1);
+}
+
+// Sustained patch on all 6 channels with a spread of pitches
+static void setup_channels(RN_Chip *chip, uint8_t algorithm, uint8_t feedback, uint8_t lfo_sens)
+{
+    for (uint32_t ch = 0; ch < 6; ch++)
+    {
+        write_channel(chip, ch, RN_FEED_ALG, (feedback << 3) | algorithm);
+        write_channel(chip, ch, RN_ST_LFOSEN, 0xC0 | lfo_sens);
+
+        for (uint32_t op = 0; op < 4; op++)
+        {
+            write_operator(chip, ch, op, RN_DT_MUL, 0x01 + op);
+            write_operator(chip, ch, op, RN_TOT_LEVEL, op == 3 ? 0x08 : 0x20);
+            write_operator(chip, ch, op, RN_RS_AR, 0x1F);
+            write_operator(chip, ch, op, RN_AM_D1R, lfo_sens ? 0x80 : 0x00);
+            write_operator(chip, ch, op, RN_D2R, 0x00);
+            write_operator(chip, ch, op, RN_D1L_RR, 0x0F);
+            write_operator(chip, ch, op, RN_PROP, 0x00);
+        }
+
+        write_channel(chip, ch, RN_FREQ_BLOCK_MSB, 0x20 | ch);
+        write_channel(chip, ch, RN_FREQ_LSB, 0x69);
+    }
+}
+
+static void key_on_all(RN_Chip *chip)
+{
+    for (uint32_t ch = 0; ch < 6; ch++)
+    {
+        write_register(chip, 0, RN_KEYONOFF, key_on_value(ch, 0x0F));
+    }
+}
+
+static void setup_silence(RN_Chip *chip, int param)
+{
+}
+
+static void setup_fm(RN_Chip *chip, int algorithm)
+{
+    setup_channels(chip, algorithm, 6, 0x00);
+    key_on_all(chip);
+}
+
+static void setup_lfo(RN_Chip *chip, int param)
+{
+    write_register(chip, 0, RN_LFO, 0x0F); // LFO on, fastest rate
+    setup_channels(chip, 4, 6, 0x37);      // AMS = 3, PMS = 7
+    key_on_all(chip);
+}
+
+static void setup_ssgeg(RN_Chip *chip, int param)
+{
+    setup_channels(chip, 7, 0, 0x00);
+
+    // Fast decays so the envelopes keep looping, one SSG-EG shape per operator
+    for (uint32_t ch = 0; ch < 6; ch++)
+    {
+        for (uint32_t op = 0; op < 4; op++)
+        {
+            write_operator(chip, ch, op, RN_AM_D1R, 0x1C);
+            write_operator(chip, ch, op, RN_D2R, 0x1C);
+            write_operator(chip, ch, op, RN_D1L_RR, 0x8F);
+            write_operator(chip, ch, op, RN_PROP, 0x08 + op * 2);
+        }
+    }
+
+    key_on_all(chip);
+}
+
+static void setup_csm(RN_Chip *chip, int param)
+{
+    setup_channels(chip, 7, 0, 0x00);
+
+    // Timer A overflows key on channel 3 in CSM mode
+    write_register(chip, 0, 0x24, 0xF0);
+    write_register(chip, 0, 0x25, 0x00);
+    write_register(chip, 0, RN_TIMERS_CH36, 0x85); // CSM, load and flag timer A
+}
+
+static void setup_dac(RN_Chip *chip, int param)
+{
+    setup_fm(chip, 4);
+    write_register(chip, 0, RN_DAC_EN, 0x80);
+    write_register(chip, 0, RN_DAC, 0x80);
+}
+
+static void tick_dac(RN_Chip *chip, uint32_t chunk)
+{
+    // ~13 kHz stream, the address stays latched at 0x2A so only data writes are needed
+    for (uint32_t i = 0; i < CHUNK_SAMPLES / 4; i++)
+    {
+        RN_ScheduleWrite(chip, 1, (uint8_t)((chunk * 37 + i * 11) ^ (i << 3)));
+    }
+}
+
+static void setup_churn(RN_Chip *chip, int param)
+{
+    setup_channels(chip, 4, 6, 0x00);
+}
+
+static void tick_churn(RN_Chip *chip, uint32_t chunk)
+{
+    // Key off/on every channel, 48 note writes 112 clocks apart nearly fill a chunk
+    RN_ScheduleWrite(chip, 0, RN_KEYONOFF);
+    for (uint32_t i = 0; i < 24; i++)
+    {
+        RN_ScheduleWrite(chip, 1, key_on_value(i % 6, 0x00));
+        RN_ScheduleWrite(chip, 1, key_on_value(i % 6, 0x0F));
+    }
+}
+
+static const Workload workloads[] =
+{
+    { "silence", 0, setup_silence, NULL },
+    { "fm-alg0", 0, setup_fm, NULL },
+    { "fm-alg1", 1, setup_fm, NULL },
+    { "fm-alg2", 2, setup_fm, NULL },
+    { "fm-alg3", 3, setup_fm, NULL },
+    { "fm-alg4", 4, setup_fm, NULL },
+    { "fm-alg5", 5, setup_fm, NULL },
+    { "fm-alg6", 6, setup_fm, NULL },
+    { "fm-alg7", 7, setup_fm, NULL },
+    { "lfo-max", 0, setup_lfo, NULL },
+    { "ssg-eg", 0, setup_ssgeg, NULL },
+    { "csm", 0, setup_csm, NULL },
+    { "dac", 0, setup_dac, tick_dac },
+    { "key-churn", 0, setup_churn, tick_churn },
+};
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Stage breakdown, only available in -Dprofiling=true builds
+static void print_profile(RN_Chip *chip)
+{
+    RN_Profile profile;
+    uint64_t total = 0;
+
+    if (!RN_GetProfile(chip, &profile)) return;
+
+    for (int stage = 0; stage < RN_STAGE_COUNT; stage++) total += profile.ticks[stage];
+    if (total == 0) return;
+
+    printf("    ");
+    for (int stage = 0; stage < RN_STAGE_COUNT; stage++)
+    {
+        printf(" %s %.1f%%", RN_GetProfileStageName((RN_ProfileStage)stage), profile.ticks[stage] * 100.0 / total);
+    }
+    printf("  (%.1f ticks/cycle)\n", (double)total / profile.cycles);
+}
+
+static void run(const Workload *workload, RN_ChipType chip_type, const char *chip_name, uint32_t seconds)
+{
+    int16_t buffer[CHUNK_SAMPLES * 2];
+    uint32_t chunks = (uint32_t)((uint64_t)RN_SAMPLE_RATE_NTSC * seconds / CHUNK_SAMPLES);
+    uint32_t checksum = 2166136261u;
+
+    RN_Chip *chip = RN_Create(chip_type);
+    if (!chip)
+    {
+        fprintf(stderr, "Failed to create chip\n");
+        exit(1);
+    }
+
+    RN_Reset(chip);
+    workload->setup(chip, workload->param);
+
+    for (uint32_t clocks = 0; clocks < WARMUP_CLOCKS; clocks += CHUNK_CLOCKS)
+    {
+        RN_Clock(chip, CHUNK_CLOCKS);
+        RN_DequeueSamples(chip, buffer, CHUNK_SAMPLES);
+    }
+
+    RN_ResetProfile(chip);
+    double start = now_seconds();
+
+    for (uint32_t chunk = 0; chunk < chunks; chunk++)
+    {
+        if (workload->tick) workload->tick(chip, chunk);
+
+        RN_Clock(chip, CHUNK_CLOCKS);
+        uint32_t count = RN_DequeueSamples(chip, buffer, CHUNK_SAMPLES);
+
+        // Keeps the output live and doubles as a quick sanity check between runs
+        for (uint32_t i = 0; i < count * 2; i++)
+        {
+            checksum = (checksum ^ (uint16_t)buffer[i]) * 16777619u;
+        }
+    }
+
+    double elapsed = now_seconds() - start;
+    double cycles = (double)chunks * CHUNK_CLOCKS;
+    double samples = (double)chunks * CHUNK_SAMPLES;
+
+    printf("%-10s %-11s %8.2f Mcycles/s %9.1f ns/sample %7.2fx realtime  (checksum %08x)\n",
+        workload->name, chip_name,
+        cycles / elapsed / 1e6,
+        elapsed / samples * 1e9,
+        samples / RN_SAMPLE_RATE_NTSC / elapsed,
+        checksum);
+
+    print_profile(chip);
+
+    RN_Destroy(chip);
+}
+
+// Clocks a chunk, through RN_ClockStems when stems is set, and dequeues it unclamped. Returns the sample count.
+static uint32_t check_chunk(RN_Chip *chip, int32_t *buffer, int32_t (*stems)[(CHUNK_SAMPLES + 1) * 2])
+{
+    if (stems)
+    {
+        void *const stem_buffers[RN_STEM_COUNT] = { stems[0], stems[1], stems[2], stems[3], stems[4], stems[5], stems[6] };
+        uint32_t stem_count = RN_ClockStems(chip, CHUNK_CLOCKS, RN_FORMAT_S32, stem_buffers);
+        uint32_t count = RN_DequeueSamplesFormat(chip, RN_FORMAT_S32, buffer, NULL, CHUNK_SAMPLES + 1);
+
+        for (uint32_t i = 0; i < count * 2; i++)
+        {
+            int32_t sum = 0;
+            for (int stem = 0; stem < RN_STEM_COUNT; stem++) sum += stems[stem][i];
+            if (stem_count != count || sum != buffer[i]) return UINT32_MAX;
+        }
+
+        return count;
+    }
+
+    RN_Clock(chip, CHUNK_CLOCKS);
+    return RN_DequeueSamplesFormat(chip, RN_FORMAT_S32, buffer, NULL, CHUNK_SAMPLES + 1);
+}
+
+// Runs the workload on the cycle-accurate core and the fast engine side by side, returns 0 when they match
+static int check(const Workload *workload, RN_ChipType chip_type, const char *chip_name, uint32_t seconds)
+{
+    static int32_t stems[2][RN_STEM_COUNT][(CHUNK_SAMPLES + 1) * 2];
+    int32_t buffers[2][(CHUNK_SAMPLES + 1) * 2];
+    uint32_t chunks = (uint32_t)((uint64_t)RN_SAMPLE_RATE_NTSC * seconds / CHUNK_SAMPLES) + WARMUP_CLOCKS / CHUNK_CLOCKS;
+    uint64_t sample = 0;
+    RN_Chip *chips[2] = { RN_Create(chip_type), RN_Create(chip_type | RNCM_FAST) };
+    int result = 0;
+
+    if (!chips[0] || !chips[1])
+    {
+        fprintf(stderr, "Failed to create chip\n");
+        exit(1);
+    }
+
+    for (int e = 0; e < 2; e++)
+    {
+        RN_Reset(chips[e]);
+        workload->setup(chips[e], workload->param);
+    }
+
+    for (uint32_t chunk = 0; chunk < chunks && result == 0; chunk++)
+    {
+        uint32_t counts[2];
+
+        for (int e = 0; e < 2; e++)
+        {
+            // The timed run starts ticking after the warmup
+            if (workload->tick && chunk >= WARMUP_CLOCKS / CHUNK_CLOCKS) workload->tick(chips[e], chunk - WARMUP_CLOCKS / CHUNK_CLOCKS);
+            counts[e] = check_chunk(chips[e], buffers[e], chunk % 2 ? stems[e] : NULL);
+
+            if (counts[e] == UINT32_MAX)
+            {
+                printf("FAIL %-10s %-11s stems do not add up to the mix%s near sample %llu\n",
+                    workload->name, chip_name, e ? " of the fast engine" : "", (unsigned long long)sample);
+                result = 1;
+            }
+        }
+
+        if (result) break;
+
+        uint32_t i;
+        for (i = 0; i < counts[0] * 2 && counts[0] == counts[1] && buffers[0][i] == buffers[1][i]; i++);
+
+        if (counts[0] != counts[1] || i < counts[0] * 2)
+        {
+            printf("FAIL %-10s %-11s fast engine differs at sample %llu\n", workload->name, chip_name, (unsigned long long)(sample + i / 2));
+            result = 1;
+        }
+
+        sample += counts[0];
+    }
+
+    if (result == 0) printf("ok   %-10s %-11s %llu samples\n", workload->name, chip_name, (unsigned long long)sample);
+
+    RN_Destroy(chips[0]);
+    RN_Destroy(chips[1]);
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t seconds = DEFAULT_SECONDS;
+    int first = 1;
+    int checking = 0;
+    int failures = 0;
+    size_t workload_count = sizeof(workloads) / sizeof(workloads[0]);
+
+    if (argc >= 2 && strcmp(argv[first], "-c") == 0)
+    {
+        checking = 1;
+        first++;
+    }
+
+    if (argc >= first + 2 && strcmp(argv[first], "-s") == 0)
+    {
+        seconds = (uint32_t)atoi(argv[first + 1]);
+        first += 2;
+    }
+
+    if (seconds == 0)
+    {
+        fprintf(stderr, "Usage: %s [-c] [-s seconds] [workload...]\n", argv[0]);
+        return 1;
+    }
+
+    for (int i = first; i < argc; i++)
+    {
+        size_t w;
+        for (w = 0; w < workload_count && strcmp(workloads[w].name, argv[i]) != 0; w++);
+
+        if (w == workload_count)
+        {
+            fprintf(stderr, "Unknown workload: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    RN_Chip *probe = RN_Create(0);
+    if (probe)
+    {
+        printf("Clock paths: %s\n", RN_GetISA(probe));
+        RN_Destroy(probe);
+    }
+
+    for (size_t w = 0; w < workload_count; w++)
+    {
+        int selected = first == argc;
+        for (int i = first; i < argc; i++)
+        {
+            if (strcmp(workloads[w].name, argv[i]) == 0) selected = 1;
+        }
+
+        if (!selected) continue;
+
+        for (size_t c = 0; c < sizeof(chip_types) / sizeof(chip_types[0]); c++)
+        {
+            if (!checking) run(&workloads[w], chip_types[c].type, chip_types[c].name, seconds);
+            else if (!(chip_types[c].type & RNCM_FAST)) failures += check(&workloads[w], chip_types[c].type, chip_types[c].name, seconds);
+        }
+    }
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,89 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "audio_ring.h"
+
+bool audio_ring_init(AudioRing *ring, uint32_t min_frames) {
+    uint32_t capacity = 256;
+    while (capacity < min_frames) capacity <<= 1;
+
+    ring->buffer = calloc(capacity, sizeof(int16_t) * 2);
+    if (!ring->buffer) return false;
+
+    ring->capacity = capacity;
+    SDL_SetAtomicInt(&ring->write_pos, 0);
+    SDL_SetAtomicInt(&ring->read_pos, 0);
+    SDL_SetAtomicInt(&ring->discard_pos, 0);
+    return true;
+}
+
+void audio_ring_free(AudioRing *ring) {
+    free(ring->buffer);
+    ring->buffer = NULL;
+    ring->capacity = 0;
+}
+
+// Read position with flushed frames already skipped
+static uint32_t effective_read_pos(AudioRing *ring) {
+    uint32_t read_pos = (uint32_t)SDL_GetAtomicInt(&ring->read_pos);
+    uint32_t discard_pos = (uint32_t)SDL_GetAtomicInt(&ring->discard_pos);
+    return (int32_t)(discard_pos - read_pos) > 0 ? discard_pos : read_pos;
+}
+
+uint32_t audio_ring_available(AudioRing *ring) {
+    uint32_t read_pos = effective_read_pos(ring);
+    uint32_t write_pos = (uint32_t)SDL_GetAtomicInt(&ring->write_pos);
+    return write_pos - read_pos;
+}
+
+uint32_t audio_ring_space(AudioRing *ring) {
+    // Flushed frames stay reserved until the consumer has skipped them, it may still be copying them out
+    uint32_t read_pos = (uint32_t)SDL_GetAtomicInt(&ring->read_pos);
+    uint32_t write_pos = (uint32_t)SDL_GetAtomicInt(&ring->write_pos);
+    return ring->capacity - (write_pos - read_pos);
+}
+
+uint32_t audio_ring_write(AudioRing *ring, const int16_t *frames, uint32_t count) {
+    uint32_t write_pos = (uint32_t)SDL_GetAtomicInt(&ring->write_pos);
+    uint32_t space = audio_ring_space(ring);
+    if (count > space) count = space;
+
+    uint32_t start = write_pos & (ring->capacity - 1);
+    uint32_t until_wrap = ring->capacity - start;
+    uint32_t first = count < until_wrap ? count : until_wrap;
+
+    memcpy(ring->buffer + start * 2, frames, first * 2 * sizeof(int16_t));
+    memcpy(ring->buffer, frames + first * 2, (count - first) * 2 * sizeof(int16_t));
+
+    // Publish the frames only after they have been copied
+    SDL_MemoryBarrierRelease();
+    SDL_SetAtomicInt(&ring->write_pos, (int)(write_pos + count));
+    return count;
+}
+
+void audio_ring_flush(AudioRing *ring) {
+    SDL_SetAtomicInt(&ring->discard_pos, SDL_GetAtomicInt(&ring->write_pos));
+}
+
+uint32_t audio_ring_peek(AudioRing *ring, const int16_t **first, uint32_t *first_count, const int16_t **second, uint32_t *second_count) {
+    // Skip frames dropped by audio_ring_flush() before exposing anything
+    uint32_t read_pos = effective_read_pos(ring);
+    SDL_SetAtomicInt(&ring->read_pos, (int)read_pos);
+    uint32_t count = (uint32_t)SDL_GetAtomicInt(&ring->write_pos) - read_pos;
+    SDL_MemoryBarrierAcquire();
+
+    uint32_t start = read_pos & (ring->capacity - 1);
+    uint32_t until_wrap = ring->capacity - start;
+
+    *first = ring->buffer + start * 2;
+    *first_count = count < until_wrap ? count : until_wrap;
+    *second = ring->buffer;
+    *second_count = count - *first_count;
+    return count;
+}
+
+void audio_ring_consume(AudioRing *ring, uint32_t count) {
+    uint32_t read_pos = (uint32_t)SDL_GetAtomicInt(&ring->read_pos);
+    SDL_MemoryBarrierRelease();
+    SDL_SetAtomicInt(&ring->read_pos, (int)(read_pos + count));
+}
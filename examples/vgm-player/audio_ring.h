@@ -0,0 +1,36 @@
+#ifndef AUDIO_RING_H
+#define AUDIO_RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <SDL3/SDL.h>
+
+// Lock-free single producer / single consumer ring of interleaved stereo int16 frames.
+// The emulation thread is the only writer and the audio callback the only reader.
+typedef struct {
+    int16_t *buffer;
+    uint32_t capacity;          // In frames, power of two
+    SDL_AtomicInt write_pos;    // Free running frame counters, only advanced by their owner
+    SDL_AtomicInt read_pos;
+    SDL_AtomicInt discard_pos;  // Set by the producer, frames before it are dropped unread by the consumer
+} AudioRing;
+
+bool audio_ring_init(AudioRing *ring, uint32_t min_frames);
+void audio_ring_free(AudioRing *ring);
+
+// Frames ready to be read
+uint32_t audio_ring_available(AudioRing *ring);
+// Frames that can be written without overwriting unread data
+uint32_t audio_ring_space(AudioRing *ring);
+
+// Producer side, returns the number of frames written
+uint32_t audio_ring_write(AudioRing *ring, const int16_t *frames, uint32_t count);
+// Producer side, drops everything written so far. The consumer skips it on its next peek.
+void audio_ring_flush(AudioRing *ring);
+
+// Consumer side. Exposes up to two contiguous regions of readable frames without copying,
+// release them with audio_ring_consume() once they are no longer needed.
+uint32_t audio_ring_peek(AudioRing *ring, const int16_t **first, uint32_t *first_count, const int16_t **second, uint32_t *second_count);
+void audio_ring_consume(AudioRing *ring, uint32_t count);
+
+#endif
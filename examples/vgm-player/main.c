@@ -8,12 +8,15 @@
 #include <assert.h>
 
 #include "renuke.h"
-#include "emu76489.h"
+#include "vgz.h"
+#include "audio_ring.h"
 
 #define ASSERT_MSG(_v, ...) if(!(_v)) { fprintf(stderr, __VA_ARGS__); fprintf(stderr, "\n"); exit(1); }
-#define CLAMP(x, low, high) (((x) < (low)) ? (low) : (((x) > (high)) ? (high) : (x)))
 #define MAX_DATA_BLOCKS 256
 #define MAX_PCM_BANKS 40
+#define MAX_CHIPS 2
+#define DEFAULT_LATENCY_MS 60
+#define RENDER_CHUNK 256    // Frames rendered per producer iteration
 
 typedef struct {
     uint8_t *data;
@@ -21,6 +24,22 @@ typedef struct {
     uint8_t type;
 } DataBlock;
 
+// Decompressed copy of a compressed data block, keyed by the block's file offset
+typedef struct {
+    uint32_t offset;
+    uint8_t *data;
+    uint32_t size;
+} DecodedBlock;
+
+// Decompression table (data block type 0x7F)
+typedef struct {
+    const uint8_t *data;
+    uint8_t sub_type;
+    uint8_t bits_decompressed;
+    uint8_t bits_compressed;
+    uint16_t value_count;
+} DecompressionTable;
+
 typedef struct {
     uint8_t *data;
     uint32_t size;
@@ -36,11 +55,13 @@ typedef struct {
     uint32_t rate;
     uint32_t data_offset;
     
-    // Chip clocks
+    // Chip clocks, with the dual chip flag (bit 30) masked off
     uint32_t sn76489_clock;
     uint32_t ym2413_clock;
     uint32_t ym2612_clock;
     uint32_t ym2151_clock;
+    bool dual_sn76489;
+    bool dual_ym2612;
     
     // Version 1.10+ fields
     uint8_t sn76489_feedback;
@@ -49,6 +70,11 @@ typedef struct {
     // Data blocks
     DataBlock data_blocks[MAX_DATA_BLOCKS];
     uint32_t data_block_count;
+
+    // Compressed data blocks are decoded once and shared from this cache
+    DecodedBlock decoded_blocks[MAX_DATA_BLOCKS];
+    uint32_t decoded_block_count;
+    DecompressionTable decompression_tables[2];
     
     // PCM data banks
     uint8_t *pcm_banks[MAX_PCM_BANKS];
@@ -58,25 +84,36 @@ typedef struct {
 
 
 typedef struct {
-    // Chip instances (single chip only)
-    RN_Chip *ym2612;
-    SNG *psg;
+    // Chip instances, the second one is only created for dual chip files
+    RN_System *systems[MAX_CHIPS];
+    uint32_t system_count;
     
     // VGM file
     VGMFile *vgm;
     
-    // Playback state
-    uint32_t samples_played;
+    // Playback state, owned by the emulation thread
     uint32_t wait_clocks;  // Wait time in YM2612 clock cycles
-    bool paused;
-    bool loop_enabled;
-    
-    // Audio buffer
-    int16_t *audio_buffer;
-    size_t audio_buffer_size;
-
-    int last_ym_port;
-    int last_ym_reg;
+    int last_ym_port[MAX_CHIPS];
+    int last_ym_reg[MAX_CHIPS];
+
+    // Controls, written by the UI thread
+    SDL_AtomicInt paused;
+    SDL_AtomicInt loop_enabled;
+    SDL_AtomicInt restart_requested;
+    SDL_AtomicInt running;
+
+    // Written by the emulation thread
+    SDL_AtomicInt finished;         // The stream has ended and all of it is in the ring
+
+    // Rendered audio, the emulation thread stays latency_frames ahead of the audio callback
+    AudioRing ring;
+    uint32_t latency_frames;
+
+    // Statistics, written by the audio callback
+    SDL_AtomicInt samples_played;
+    SDL_AtomicInt lead_frames;      // Frames buffered when the last callback ran
+    SDL_AtomicInt min_lead_frames;  // Lowest lead seen since the start of playback
+    SDL_AtomicInt underruns;        // Callbacks that had to be padded with silence
 } PlayerState;
 
 static uint32_t read_u32_le(const uint8_t *data) {
@@ -92,25 +129,11 @@ static uint8_t read_u8(const uint8_t *data) {
 }
 
 static VGMFile* load_vgm(const char *filename) {
-    FILE *f = fopen(filename, "rb");
-    ASSERT_MSG(f, "Failed to open: %s", filename)
-
-    fseek(f, 0, SEEK_END);
-    size_t size = ftell(f);
-    fseek(f, 0, SEEK_SET);
-
-    uint8_t *data = malloc(size);
-    if (!data) {
-        fclose(f);
-        return NULL;
-    }
-
-    if (fread(data, 1, size, f) != size) {
-        free(data);
-        fclose(f);
-        return NULL;
-    }
-    fclose(f);
+    // VGZ files are inflated while reading
+    size_t size;
+    uint8_t *data = vgz_read_file(filename, &size);
+    ASSERT_MSG(data, "Failed to read: %s", filename)
+    ASSERT_MSG(size >= 0x40, "Not a VGM file");
 
     ASSERT_MSG(memcmp(data, "Vgm ", 4) == 0, "Not a VGM file");
 
@@ -146,6 +169,12 @@ static VGMFile* load_vgm(const char *filename) {
         vgm->ym2151_clock = read_u32_le(data + 0x30);
     }
     
+    // Bit 30 of a chip clock requests a second instance of that chip, bit 31 selects variants (T6W28, YM3438) we don't distinguish
+    vgm->dual_sn76489 = (vgm->sn76489_clock & 0x40000000) != 0;
+    vgm->dual_ym2612 = (vgm->ym2612_clock & 0x40000000) != 0;
+    vgm->sn76489_clock &= 0x3FFFFFFF;
+    vgm->ym2612_clock &= 0x3FFFFFFF;
+    
     // Version 1.50+ fields
     if (vgm->version >= 0x150) {
         uint32_t vgm_data_offset = read_u32_le(data + 0x34);
@@ -163,6 +192,95 @@ static VGMFile* load_vgm(const char *filename) {
     return vgm;
 }
 
+typedef struct {
+    const uint8_t *data;
+    uint32_t size;
+    uint32_t bit_pos;
+} BitReader;
+
+// Reads MSB first, as used by the VGM bit packing format
+static uint32_t read_bits(BitReader *r, uint32_t bits) {
+    uint32_t value = 0;
+    while (bits--) {
+        uint32_t byte = r->bit_pos >> 3;
+        uint32_t bit = byte < r->size ? (r->data[byte] >> (7 - (r->bit_pos & 7))) & 1 : 0;
+        value = (value << 1) | bit;
+        r->bit_pos++;
+    }
+    return value;
+}
+
+static uint8_t* decode_compressed_block(VGMFile *vgm, const uint8_t *block, uint32_t block_size, uint32_t *decoded_size) {
+    ASSERT_MSG(block_size >= 10, "Truncated compressed data block");
+
+    uint8_t compression = block[0];
+    uint32_t size = read_u32_le(block + 1);
+    uint8_t bits_decompressed = block[5];
+    uint8_t bits_compressed = block[6];
+    uint8_t sub_type = block[7];
+    uint16_t add_value = read_u16_le(block + 8);
+
+    ASSERT_MSG(compression <= 0x01, "Unknown data block compression: 0x%02X", compression);
+    ASSERT_MSG(bits_compressed >= 1 && bits_compressed <= 16 && bits_decompressed >= 1 && bits_decompressed <= 16,
+        "Unsupported data block bit widths: %u -> %u", bits_compressed, bits_decompressed);
+
+    uint32_t value_size = (bits_decompressed + 7) / 8;
+    const DecompressionTable *table = &vgm->decompression_tables[compression];
+    bool use_table = compression == 0x01 || sub_type == 0x02;
+    if (use_table) {
+        ASSERT_MSG(table->data && table->bits_compressed == bits_compressed && table->bits_decompressed == bits_decompressed,
+            "Missing decompression table for data block");
+    }
+
+    uint8_t *out = malloc(size ? size : 1);
+    ASSERT_MSG(out, "Failed to allocate data block");
+
+    BitReader reader = { block + 10, block_size - 10, 0 };
+    uint32_t out_mask = bits_decompressed < 16 ? (1u << bits_decompressed) - 1 : 0xFFFF;
+    uint32_t value = add_value;
+
+    for (uint32_t pos = 0; pos + value_size <= size; pos += value_size) {
+        uint32_t in = read_bits(&reader, bits_compressed);
+        uint32_t entry = 0;
+        if (use_table) {
+            ASSERT_MSG(in < table->value_count, "Decompression table index out of range");
+            entry = value_size == 1 ? table->data[in] : read_u16_le(table->data + in * 2);
+        }
+
+        if (compression == 0x01) {
+            // DPCM
+            value = (value + entry) & out_mask;
+        } else {
+            // Bit packing
+            switch (sub_type) {
+                case 0x00: value = in + add_value; break;
+                case 0x01: value = (in << (bits_decompressed - bits_compressed)) + add_value; break;
+                case 0x02: value = entry; break;
+                default: ASSERT_MSG(0, "Unknown bit packing sub type: 0x%02X", sub_type); break;
+            }
+        }
+
+        out[pos] = value & 0xFF;
+        if (value_size == 2) out[pos + 1] = (value >> 8) & 0xFF;
+    }
+
+    *decoded_size = size;
+    return out;
+}
+
+static DecodedBlock* get_decoded_block(VGMFile *vgm, uint32_t offset, uint32_t block_size) {
+    // Loops can replay data block commands, only decode each block once
+    for (uint32_t i = 0; i < vgm->decoded_block_count; i++) {
+        if (vgm->decoded_blocks[i].offset == offset) return &vgm->decoded_blocks[i];
+    }
+
+    ASSERT_MSG(vgm->decoded_block_count < MAX_DATA_BLOCKS, "Too many compressed data blocks");
+    DecodedBlock *decoded = &vgm->decoded_blocks[vgm->decoded_block_count++];
+    decoded->offset = offset;
+    decoded->data = decode_compressed_block(vgm, vgm->data + offset, block_size, &decoded->size);
+    return decoded;
+}
+
 static void process_data_block(VGMFile *vgm, PlayerState *state) {
     if (vgm->pos + 6 >= vgm->size) return;
     uint8_t b = vgm->data[vgm->pos++];
@@ -185,7 +303,7 @@ static void process_data_block(VGMFile *vgm, PlayerState *state) {
         vgm->data_block_count++;
     }
     
-    ASSERT_MSG(block_type <= 0x3F, "Only uncompressed data streams supported");
+    ASSERT_MSG(block_type <= 0x7F, "Only data streams supported");
 
     // Handle specific block types
     if (block_type <= 0x3F) {
@@ -196,6 +314,32 @@ static void process_data_block(VGMFile *vgm, PlayerState *state) {
         vgm->pcm_banks[block_type] = vgm->data + vgm->pos;
         vgm->pcm_bank_sizes[block_type] = block_size;
         vgm->pcm_bank_pos[block_type] = 0;
+    } else if (block_type <= 0x7E) {
+        // Compressed stream, decoded into the cache
+        uint8_t bank = block_type - 0x40;
+
+        ASSERT_MSG(bank < MAX_PCM_BANKS, "Too many data banks")
+
+        DecodedBlock *decoded = get_decoded_block(vgm, vgm->pos, block_size);
+        vgm->pcm_banks[bank] = decoded->data;
+        vgm->pcm_bank_sizes[bank] = decoded->size;
+        vgm->pcm_bank_pos[bank] = 0;
+    } else {
+        // Decompression table
+        ASSERT_MSG(block_size >= 6, "Truncated decompression table");
+
+        uint8_t compression = vgm->data[vgm->pos];
+        ASSERT_MSG(compression <= 0x01, "Unknown data block compression: 0x%02X", compression);
+
+        DecompressionTable *table = &vgm->decompression_tables[compression];
+        table->sub_type = vgm->data[vgm->pos + 1];
+        table->bits_decompressed = vgm->data[vgm->pos + 2];
+        table->bits_compressed = vgm->data[vgm->pos + 3];
+        table->value_count = read_u16_le(&vgm->data[vgm->pos + 4]);
+        table->data = &vgm->data[vgm->pos + 6];
+
+        uint32_t value_size = (table->bits_decompressed + 7) / 8;
+        ASSERT_MSG(6 + table->value_count * value_size <= block_size, "Truncated decompression table");
     }
     
     vgm->pos += block_size;
@@ -208,17 +352,26 @@ static inline uint32_t vgm_samples_to_clocks(VGMFile *vgm, uint32_t vgm_samples)
     return (uint32_t)((uint64_t)vgm_samples * vgm->ym2612_clock / (44100 * 6));
 }
 
-void ym_write(PlayerState *state, uint32_t port, uint8_t reg, uint8_t val)
+// Writes for a chip that isn't present (eg. 0xA2 in a single chip file) go nowhere
+static RN_System *get_system(PlayerState *state, uint32_t chip)
+{
+    return chip < state->system_count ? state->systems[chip] : NULL;
+}
+
+void ym_write(PlayerState *state, uint32_t chip, uint32_t port, uint8_t reg, uint8_t val)
 {
-    if (state->last_ym_port != port || state->last_ym_reg != reg)
+    RN_System *system = get_system(state, chip);
+    if (!system) return;
+
+    if (state->last_ym_port[chip] != port || state->last_ym_reg[chip] != reg)
     {
-        RN_ScheduleWrite(state->ym2612, port, reg);
+        RN_SystemWriteYM(system, port, reg);
 
-        state->last_ym_reg = reg;
-        state->last_ym_port = port;
+        state->last_ym_reg[chip] = reg;
+        state->last_ym_port[chip] = port;
     }
 
-    RN_ScheduleWrite(state->ym2612, port + 1, val);
+    RN_SystemWriteYM(system, port + 1, val);
 }
 
 static void process_vgm_command(VGMFile *vgm, PlayerState *state)
@@ -229,31 +382,34 @@ static void process_vgm_command(VGMFile *vgm, PlayerState *state)
     uint8_t cmd = vgm->data[vgm->pos++];
     
     switch (cmd) {
+        case 0x3F: // Game Gear PSG stereo, second chip
         case 0x4F: // Game Gear PSG stereo
             if (vgm->pos < vgm->size) {
                 uint8_t val = vgm->data[vgm->pos++];
-                if (state->psg) {
-                    SNG_writeGGIO(state->psg, val);
-                }
+                RN_System *system = get_system(state, cmd == 0x3F ? 1 : 0);
+                if (system) RN_SystemWritePSGStereo(system, val);
             }
             break;
             
+        case 0x30: // PSG write, second chip
         case 0x50: // PSG write
             if (vgm->pos < vgm->size) {
                 uint8_t val = vgm->data[vgm->pos++];
-                if (state->psg) {
-                    SNG_writeIO(state->psg, val);
-                }
+                RN_System *system = get_system(state, cmd == 0x30 ? 1 : 0);
+                if (system) RN_SystemWritePSG(system, val);
             }
             break;
             
         case 0x52: // YM2612 port 0 write
         case 0x53: // YM2612 port 1 write
+        case 0xA2: // YM2612 port 0 write, second chip
+        case 0xA3: // YM2612 port 1 write, second chip
             if (vgm->pos + 1 < vgm->size) {
                 uint8_t reg = vgm->data[vgm->pos++];
                 uint8_t val = vgm->data[vgm->pos++];
-                uint32_t port = (cmd == 0x52) ? 0 : 2;
-                ym_write(state, port, reg, val);
+                uint32_t chip = (cmd & 0xF0) == 0xA0 ? 1 : 0;
+                uint32_t port = (cmd & 0x01) ? 2 : 0;
+                ym_write(state, chip, port, reg, val);
             }
             break;
             
@@ -274,7 +430,7 @@ static void process_vgm_command(VGMFile *vgm, PlayerState *state)
             break;
             
         case 0x66: // End of sound data
-            if (state->loop_enabled && vgm->loop_offset) {
+            if (SDL_GetAtomicInt(&state->loop_enabled) && vgm->loop_offset) {
                 vgm->pos = 0x1C + vgm->loop_offset;
             } else {
                 vgm->pos = vgm->size;
@@ -294,7 +450,7 @@ static void process_vgm_command(VGMFile *vgm, PlayerState *state)
             // Read from data bank 0 at current position
             if (vgm->pcm_banks[0] && vgm->pcm_bank_pos[0] < vgm->pcm_bank_sizes[0]) {
                 uint8_t data = vgm->pcm_banks[0][vgm->pcm_bank_pos[0]++];
-                ym_write(state, 0, 0x2A, data);
+                ym_write(state, 0, 0, 0x2A, data);
             }
             break;
             
@@ -317,70 +473,137 @@ static void process_vgm_command(VGMFile *vgm, PlayerState *state)
     }
 }
 
-static void audio_callback(void *userdata, SDL_AudioStream *stream, int additional_amount, int total_amount) {
-    PlayerState *state = (PlayerState*)userdata;
-    
-    if (state->paused || !state->vgm) {
-        return;
-    }
-    
-    int samples_needed = additional_amount / (sizeof(int16_t) * 2);
-    
-    // Reallocate buffer if needed
-    if (state->audio_buffer_size < additional_amount) {
-        state->audio_buffer = realloc(state->audio_buffer, additional_amount);
-        ASSERT_MSG(state->audio_buffer, "Failed to allocate audio buffer");
-        state->audio_buffer_size = additional_amount;
-    }
-    
-    int16_t* cur_buffer = state->audio_buffer;
-    
-    while (samples_needed > 0) {
+static void render(PlayerState *state, int16_t *out, int frames) {
+    while (frames > 0) {
         // Process VGM commands if no wait pending
         while (state->wait_clocks == 0 && state->vgm->pos < state->vgm->size) {
             process_vgm_command(state->vgm, state);
         }
         
-        // Clock the chip with the wait clocks (or 512, one sample, if wait_clocks is 0 at this point, ie. the song has ended)
+        // Clock the chip with the wait clocks (or 24, one sample, if wait_clocks is 0 at this point, ie. the song has ended)
         int wait_clocks = state->wait_clocks > 0 ? state->wait_clocks : 24;
         int clocks_to_run = wait_clocks > 512 ? 512 : wait_clocks;
-        RN_Clock(state->ym2612, clocks_to_run);
+        for (uint32_t i = 0; i < state->system_count; i++) {
+            RN_SystemClock(state->systems[i], clocks_to_run);
+        }
         state->wait_clocks -= clocks_to_run;
         
-        // Generate samples while we have queued samples and need more output
-        int16_t buffer[256 * 2];
-        int samples_dequeued = RN_DequeueSamples(state->ym2612, buffer, samples_needed > 256 ? 256 : samples_needed);
-        
-        for(int i = 0; i < samples_dequeued; i++)
-        {
-            int32_t psg_out[2] = {0, 0};
-            int16_t* ym_out = buffer + i * 2;
-            
-            SNG_calc_stereo(state->psg, psg_out);
-            
-            int32_t psg_gain = 4;
+        // Mixed YM2612 + PSG output of all chips, straight into the output buffer
+        int samples_dequeued = RN_SystemDequeueMixed(state->systems, state->system_count, out, frames);
 
-            // Mix outputs with proper clamping
-            int32_t left = ym_out[0] + (psg_out[0] * psg_gain);
-            int32_t right = ym_out[1] + (psg_out[1] * psg_gain);
-            
-            *(cur_buffer++) = CLAMP(left, -32768, 32767);
-            *(cur_buffer++) = CLAMP(right, -32768, 32767);
-            
-            state->samples_played++;
+        out += samples_dequeued * 2;
+        frames -= samples_dequeued;
+    }
+}
+
+static int emulation_thread(void *userdata) {
+    PlayerState *state = (PlayerState*)userdata;
+    int16_t buffer[RENDER_CHUNK * 2];
+
+    SDL_SetCurrentThreadPriority(SDL_THREAD_PRIORITY_HIGH);
+
+    while (SDL_GetAtomicInt(&state->running)) {
+        if (SDL_GetAtomicInt(&state->restart_requested)) {
+            SDL_SetAtomicInt(&state->restart_requested, 0);
+            state->vgm->pos = state->vgm->data_offset;
+            state->wait_clocks = 0;
+            for (uint32_t i = 0; i < state->system_count; i++) {
+                state->last_ym_port[i] = -1;
+                state->last_ym_reg[i] = -1;
+                RN_SystemReset(state->systems[i]);
+            }
+            // Audio rendered before the restart must not be played after it
+            audio_ring_flush(&state->ring);
+            SDL_SetAtomicInt(&state->samples_played, 0);
+            SDL_SetAtomicInt(&state->finished, 0);
+        }
+
+        // Nothing is left to render after the end, the callback plays out what is in the ring
+        if (SDL_GetAtomicInt(&state->finished)) {
+            SDL_Delay(1);
+            continue;
+        }
+
+        // Render ahead until the latency target is buffered, then wait for the callback to drain it
+        uint32_t buffered = audio_ring_available(&state->ring);
+        if (buffered >= state->latency_frames) {
+            SDL_Delay(1);
+            continue;
         }
 
-        samples_needed -= samples_dequeued;
+        uint32_t frames = state->latency_frames - buffered;
+        if (frames > RENDER_CHUNK) frames = RENDER_CHUNK;
+        // Right after a restart the flushed frames can still occupy the ring
+        uint32_t space = audio_ring_space(&state->ring);
+        if (frames > space) frames = space;
+        if (frames == 0) {
+            SDL_Delay(1);
+            continue;
+        }
+
+        render(state, buffer, frames);
+        audio_ring_write(&state->ring, buffer, frames);
+
+        if (state->vgm->pos >= state->vgm->size && state->wait_clocks == 0) {
+            SDL_SetAtomicInt(&state->finished, 1);
+        }
+    }
+
+    return 0;
+}
+
+static void audio_callback(void *userdata, SDL_AudioStream *stream, int additional_amount, int total_amount) {
+    static const int16_t silence[RENDER_CHUNK * 2];
+    PlayerState *state = (PlayerState*)userdata;
+    
+    if (SDL_GetAtomicInt(&state->paused)) {
+        return;
     }
     
-    SDL_PutAudioStreamData(stream, state->audio_buffer, additional_amount);
+    uint32_t frames_needed = additional_amount / (sizeof(int16_t) * 2);
+
+    // Only copy out what the emulation thread has already rendered
+    const int16_t *first, *second;
+    uint32_t first_count, second_count;
+    uint32_t available = audio_ring_peek(&state->ring, &first, &first_count, &second, &second_count);
+
+    if (first_count > frames_needed) first_count = frames_needed;
+    if (second_count > frames_needed - first_count) second_count = frames_needed - first_count;
+    uint32_t frames = first_count + second_count;
+
+    SDL_PutAudioStreamData(stream, first, first_count * sizeof(int16_t) * 2);
+    SDL_PutAudioStreamData(stream, second, second_count * sizeof(int16_t) * 2);
+    audio_ring_consume(&state->ring, frames);
+
+    if (frames < frames_needed) {
+        // Underrun, keep the device fed with silence rather than stalling. After the end there is nothing to wait for.
+        if (!SDL_GetAtomicInt(&state->finished)) SDL_AddAtomicInt(&state->underruns, 1);
+        uint32_t missing = frames_needed - frames;
+        while (missing > 0) {
+            uint32_t n = missing > RENDER_CHUNK ? RENDER_CHUNK : missing;
+            SDL_PutAudioStreamData(stream, silence, n * sizeof(int16_t) * 2);
+            missing -= n;
+        }
+    }
+
+    int lead = (int)(available - frames);
+    SDL_SetAtomicInt(&state->lead_frames, lead);
+    if (lead < SDL_GetAtomicInt(&state->min_lead_frames)) {
+        SDL_SetAtomicInt(&state->min_lead_frames, lead);
+    }
+    SDL_AddAtomicInt(&state->samples_played, (int)frames);
 }
 
 int main(int argc, char *argv[]) {
-    ASSERT_MSG(argc == 2, "Usage: %s <vgm_file>", argv[0])
+    int latency_ms = DEFAULT_LATENCY_MS;
+    if (argc == 4 && strcmp(argv[1], "-l") == 0) {
+        latency_ms = atoi(argv[2]);
+        argv += 2;
+        argc -= 2;
+    }
+    ASSERT_MSG(argc == 2 && latency_ms > 0, "Usage: %s [-l latency_ms] <vgm_file>", argv[0])
     
     VGMFile *vgm = load_vgm(argv[1]);
-    ASSERT_MSG(vgm->ym2612_clock < 0x40000000 || vgm->sn76489_clock < 0x40000000, "Dual chips is not supported");
     
     bool result = SDL_Init(SDL_INIT_AUDIO | SDL_INIT_VIDEO);
     ASSERT_MSG(result, "SDL init failed: %s", SDL_GetError());
@@ -392,17 +615,26 @@ int main(int argc, char *argv[]) {
     ASSERT_MSG(renderer, "Failed to create renderer: %s", SDL_GetError());
     
     PlayerState state = {0};
-    state.last_ym_reg = -1;
-    state.last_ym_port = -1;
+    for (int i = 0; i < MAX_CHIPS; i++) {
+        state.last_ym_reg[i] = -1;
+        state.last_ym_port[i] = -1;
+    }
     state.vgm = vgm;
-    state.loop_enabled = true;
+    SDL_SetAtomicInt(&state.loop_enabled, 1);
+    SDL_SetAtomicInt(&state.running, 1);
     
     int sample_rate = vgm->rate == 50 ? RN_SAMPLE_RATE_PAL : RN_SAMPLE_RATE_NTSC;
 
-    // Create chip emulators
-    state.ym2612 = RN_Create(RNCM_YM2612);
-    state.psg = SNG_new(vgm->sn76489_clock, sample_rate);
-    SNG_reset(state.psg);
+    state.latency_frames = (uint32_t)((int64_t)sample_rate * latency_ms / 1000);
+    SDL_SetAtomicInt(&state.min_lead_frames, (int)state.latency_frames);
+    ASSERT_MSG(audio_ring_init(&state.ring, state.latency_frames + RENDER_CHUNK), "Failed to allocate audio ring");
+
+    // Create chip emulators, a second YM2612 + PSG pair for dual chip files
+    state.system_count = (vgm->dual_ym2612 || vgm->dual_sn76489) ? 2 : 1;
+    for (uint32_t i = 0; i < state.system_count; i++) {
+        state.systems[i] = RN_SystemCreate(RNCM_YM2612, vgm->rate == 50 ? RN_REGION_PAL : RN_REGION_NTSC, vgm->sn76489_clock);
+        ASSERT_MSG(state.systems[i], "Failed to create chips");
+    }
     
     // Setup audio
     SDL_AudioSpec spec = {
@@ -413,6 +645,10 @@ int main(int argc, char *argv[]) {
     
     SDL_AudioStream *audio_stream = SDL_OpenAudioDeviceStream(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &spec, audio_callback, &state);
     ASSERT_MSG(audio_stream, "Failed to open audio: %s", SDL_GetError())
+
+    // Emulation runs on its own thread, the audio callback only copies rendered frames
+    SDL_Thread *emulation = SDL_CreateThread(emulation_thread, "emulation", &state);
+    ASSERT_MSG(emulation, "Failed to create emulation thread: %s", SDL_GetError())
     
     SDL_ResumeAudioStreamDevice(audio_stream);
     
@@ -426,17 +662,15 @@ int main(int argc, char *argv[]) {
             } else if (event.type == SDL_EVENT_KEY_DOWN) {
                 switch (event.key.key) {
                     case SDLK_SPACE:
-                        state.paused = !state.paused;
+                        SDL_SetAtomicInt(&state.paused, !SDL_GetAtomicInt(&state.paused));
                         break;
                         
                     case SDLK_L:
-                        state.loop_enabled = !state.loop_enabled;
+                        SDL_SetAtomicInt(&state.loop_enabled, !SDL_GetAtomicInt(&state.loop_enabled));
                         break;
                         
                     case SDLK_R:
-                        vgm->pos = vgm->data_offset;
-                        state.samples_played = 0;
-                        state.wait_clocks = 0;
+                        SDL_SetAtomicInt(&state.restart_requested, 1);
                         break;
                         
                     case SDLK_Q:
@@ -467,8 +701,8 @@ int main(int argc, char *argv[]) {
         uint32_t loop_offset = vgm->loop_offset / 44100;
 
         DRAW_TEXT("VGM version: %x.%02x\n", (vgm->version >> 8) & 0xFF, vgm->version & 0xFF);
-        DRAW_TEXT("YM2612: %u Hz", vgm->ym2612_clock);
-        DRAW_TEXT("SN76489: %u Hz", vgm->sn76489_clock);
+        DRAW_TEXT("YM2612: %u Hz%s", vgm->ym2612_clock, vgm->dual_ym2612 ? " (x2)" : "");
+        DRAW_TEXT("SN76489: %u Hz%s", vgm->sn76489_clock, vgm->dual_sn76489 ? " (x2)" : "");
         col += 10;
         
         DRAW_TEXT("Loop offset: %02u:%02u", loop_offset / 60, loop_offset % 60);
@@ -477,10 +711,18 @@ int main(int argc, char *argv[]) {
         
         // Show playback status
         uint32_t total_time = vgm->sample_count / 44100;
-        uint32_t current_time = state.samples_played / sample_rate;
+        uint32_t current_time = (uint32_t)SDL_GetAtomicInt(&state.samples_played) / sample_rate;
         DRAW_TEXT("Time: %02u:%02u / %02u:%02u", current_time / 60, current_time % 60, total_time / 60, total_time % 60);
-        DRAW_TEXT("Status: %s", state.paused ? "PAUSED" : "PLAYING");
-        DRAW_TEXT("Looping: %s", state.loop_enabled ? "ON" : "OFF");
+        DRAW_TEXT("Status: %s", SDL_GetAtomicInt(&state.paused) ? "PAUSED" : "PLAYING");
+        DRAW_TEXT("Looping: %s", SDL_GetAtomicInt(&state.loop_enabled) ? "ON" : "OFF");
+        col += 10;
+
+        // Show how far the emulation thread is ahead of the audio device
+        DRAW_TEXT("Buffer: %d ms (min %d ms, target %d ms)",
+            SDL_GetAtomicInt(&state.lead_frames) * 1000 / sample_rate,
+            SDL_GetAtomicInt(&state.min_lead_frames) * 1000 / sample_rate,
+            latency_ms);
+        DRAW_TEXT("Underruns: %d", SDL_GetAtomicInt(&state.underruns));
         col += 10;
         
         // Show controls
@@ -493,20 +735,26 @@ int main(int argc, char *argv[]) {
         SDL_RenderPresent(renderer);
         SDL_Delay(16); // ~60 FPS
         
-        // Check if playback finished
-        if (!state.loop_enabled && vgm->pos >= vgm->size) {
+        // Quit once the stream has ended and the audio callback has taken all of it from the ring
+        if (!SDL_GetAtomicInt(&state.loop_enabled) && SDL_GetAtomicInt(&state.finished) && audio_ring_available(&state.ring) == 0) {
             running = false;
         }
     }
     
     SDL_DestroyAudioStream(audio_stream);
+    SDL_SetAtomicInt(&state.running, 0);
+    SDL_WaitThread(emulation, NULL);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     
     // Cleanup
-    if (state.ym2612) RN_Destroy(state.ym2612);
-    if (state.psg) SNG_delete(state.psg);
-    free(state.audio_buffer);
+    for (uint32_t i = 0; i < state.system_count; i++) {
+        RN_SystemDestroy(state.systems[i]);
+    }
+    audio_ring_free(&state.ring);
+    for (uint32_t i = 0; i < vgm->decoded_block_count; i++) {
+        free(vgm->decoded_blocks[i].data);
+    }
     free(vgm->data);
     free(vgm);
     SDL_Quit();
@@ -0,0 +1,463 @@
+// Minimal streaming gzip reader (RFC 1951 inflate + RFC 1952 framing) for VGZ files
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "vgz.h"
+
+#define VGZ_CHUNK 65536
+#define FAST_BITS 9
+#define MAX_BITS 15
+#define VGZ_MAX_HINT (256u << 20)
+
+typedef struct {
+    uint16_t count[MAX_BITS + 1];   // Number of codes of each length
+    uint16_t symbol[288];           // Symbols ordered by code
+    uint16_t fast[1 << FAST_BITS];  // (symbol << 4) | length for short codes, 0 if the code is longer
+} Huffman;
+
+typedef struct {
+    FILE *f;
+    uint8_t in[VGZ_CHUNK];
+    size_t in_pos;
+    size_t in_len;
+    uint32_t overrun;   // Zero bytes fed past the end of the input
+
+    uint32_t bitbuf;
+    uint32_t bitcnt;
+    bool error;
+
+    uint8_t *out;
+    size_t out_len;
+    size_t out_cap;
+
+    Huffman lencode;
+    Huffman distcode;
+} Inflater;
+
+static const uint16_t length_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t length_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+static const uint8_t codelen_order[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+static uint32_t crc_table[256];
+
+static void crc_init(void) {
+    if (crc_table[1]) return;
+    for (uint32_t n = 0; n < 256; n++) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        crc_table[n] = c;
+    }
+}
+
+static uint32_t crc_update(uint32_t crc, const uint8_t *data, size_t len) {
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc = crc_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static bool next_byte(Inflater *s, uint8_t *byte) {
+    if (s->in_pos == s->in_len) {
+        s->in_len = fread(s->in, 1, sizeof(s->in), s->f);
+        s->in_pos = 0;
+        if (s->in_len == 0) return false;
+    }
+    *byte = s->in[s->in_pos++];
+    return true;
+}
+
+// Keeps at least 25 bits buffered, padding with zeros past the end of the input
+static inline void refill(Inflater *s) {
+    while (s->bitcnt <= 24) {
+        uint8_t byte;
+        if (!next_byte(s, &byte)) {
+            byte = 0;
+            s->overrun++;
+        }
+        s->bitbuf |= (uint32_t)byte << s->bitcnt;
+        s->bitcnt += 8;
+    }
+}
+
+static inline void consume(Inflater *s, uint32_t n) {
+    s->bitbuf >>= n;
+    s->bitcnt -= n;
+    if (s->bitcnt < s->overrun * 8) {
+        // Consumed padding, the stream is truncated
+        s->error = true;
+    }
+}
+
+static inline uint32_t get_bits(Inflater *s, uint32_t n) {
+    refill(s);
+    uint32_t v = s->bitbuf & ((1u << n) - 1);
+    consume(s, n);
+    return v;
+}
+
+static bool build_huffman(Huffman *h, const uint8_t *lengths, uint32_t n) {
+    uint16_t offs[MAX_BITS + 1];
+
+    memset(h->count, 0, sizeof(h->count));
+    memset(h->fast, 0, sizeof(h->fast));
+    for (uint32_t i = 0; i < n; i++) {
+        h->count[lengths[i]]++;
+    }
+    if (h->count[0] == n) return true; // No codes, only valid for an unused distance tree
+
+    // Reject over-subscribed code sets
+    int left = 1;
+    for (int len = 1; len <= MAX_BITS; len++) {
+        left <<= 1;
+        left -= h->count[len];
+        if (left < 0) return false;
+    }
+
+    offs[1] = 0;
+    for (int len = 1; len < MAX_BITS; len++) {
+        offs[len + 1] = offs[len] + h->count[len];
+    }
+
+    uint32_t code = 0;
+    uint16_t next_code[MAX_BITS + 1];
+    h->count[0] = 0;
+    for (int len = 1; len <= MAX_BITS; len++) {
+        code = (code + h->count[len - 1]) << 1;
+        next_code[len] = code;
+    }
+
+    for (uint32_t sym = 0; sym < n; sym++) {
+        uint32_t len = lengths[sym];
+        if (len == 0) continue;
+        h->symbol[offs[len]++] = sym;
+
+        if (len <= FAST_BITS) {
+            // Codes are stored MSB first, the bit buffer is LSB first
+            uint32_t c = next_code[len];
+            uint32_t rev = 0;
+            for (uint32_t i = 0; i < len; i++) {
+                rev = (rev << 1) | ((c >> i) & 1);
+            }
+            for (uint32_t i = rev; i < (1u << FAST_BITS); i += 1u << len) {
+                h->fast[i] = (sym << 4) | len;
+            }
+        }
+        next_code[len]++;
+    }
+    return true;
+}
+
+static int decode(Inflater *s, const Huffman *h) {
+    refill(s);
+    uint16_t entry = h->fast[s->bitbuf & ((1 << FAST_BITS) - 1)];
+    if (entry) {
+        consume(s, entry & 0x0F);
+        return entry >> 4;
+    }
+
+    // Canonical decode, one bit at a time
+    int code = 0, first = 0, index = 0;
+    for (int len = 1; len <= MAX_BITS; len++) {
+        code |= (s->bitbuf >> (len - 1)) & 1;
+        int count = h->count[len];
+        if (code - count < first) {
+            consume(s, len);
+            return h->symbol[index + (code - first)];
+        }
+        index += count;
+        first += count;
+        first <<= 1;
+        code <<= 1;
+    }
+    s->error = true;
+    return -1;
+}
+
+static bool reserve_output(Inflater *s, size_t extra) {
+    if (s->out_len + extra <= s->out_cap) return true;
+
+    size_t cap = s->out_cap ? s->out_cap : VGZ_CHUNK;
+    while (cap < s->out_len + extra) cap *= 2;
+
+    uint8_t *out = realloc(s->out, cap);
+    if (!out) return false;
+    s->out = out;
+    s->out_cap = cap;
+    return true;
+}
+
+static bool inflate_stored(Inflater *s) {
+    // Skip to byte boundary
+    consume(s, s->bitcnt & 7);
+    uint32_t len = get_bits(s, 16);
+    uint32_t nlen = get_bits(s, 16);
+    if (s->error || len != (~nlen & 0xFFFF)) return false;
+    if (!reserve_output(s, len)) return false;
+
+    // Drain whole bytes still held in the bit buffer without refilling it, then copy straight from the input
+    while (len && s->bitcnt >= 8) {
+        s->out[s->out_len++] = s->bitbuf & 0xFF;
+        consume(s, 8);
+        len--;
+    }
+    while (len) {
+        if (s->in_pos == s->in_len) {
+            s->in_len = fread(s->in, 1, sizeof(s->in), s->f);
+            s->in_pos = 0;
+            if (s->in_len == 0) return false;
+        }
+        size_t n = s->in_len - s->in_pos;
+        if (n > len) n = len;
+        memcpy(s->out + s->out_len, s->in + s->in_pos, n);
+        s->out_len += n;
+        s->in_pos += n;
+        len -= n;
+    }
+    return !s->error;
+}
+
+static bool inflate_codes(Inflater *s) {
+    for (;;) {
+        int sym = decode(s, &s->lencode);
+        if (s->error || sym < 0) return false;
+
+        if (sym < 256) {
+            if (!reserve_output(s, 1)) return false;
+            s->out[s->out_len++] = sym;
+        } else if (sym == 256) {
+            return true;
+        } else {
+            sym -= 257;
+            if (sym >= 29) return false;
+            uint32_t len = length_base[sym] + get_bits(s, length_extra[sym]);
+
+            int dsym = decode(s, &s->distcode);
+            if (s->error || dsym < 0 || dsym >= 30) return false;
+            uint32_t dist = dist_base[dsym] + get_bits(s, dist_extra[dsym]);
+            if (dist > s->out_len) return false;
+            if (!reserve_output(s, len)) return false;
+
+            // Matches may overlap their own output
+            uint8_t *dst = s->out + s->out_len;
+            const uint8_t *src = dst - dist;
+            for (uint32_t i = 0; i < len; i++) {
+                dst[i] = src[i];
+            }
+            s->out_len += len;
+        }
+    }
+}
+
+static bool inflate_fixed(Inflater *s) {
+    uint8_t lengths[288];
+    uint32_t sym = 0;
+    for (; sym < 144; sym++) lengths[sym] = 8;
+    for (; sym < 256; sym++) lengths[sym] = 9;
+    for (; sym < 280; sym++) lengths[sym] = 7;
+    for (; sym < 288; sym++) lengths[sym] = 8;
+    build_huffman(&s->lencode, lengths, 288);
+
+    for (sym = 0; sym < 30; sym++) lengths[sym] = 5;
+    build_huffman(&s->distcode, lengths, 30);
+
+    return inflate_codes(s);
+}
+
+static bool inflate_dynamic(Inflater *s) {
+    uint8_t lengths[320];
+    uint32_t nlen = get_bits(s, 5) + 257;
+    uint32_t ndist = get_bits(s, 5) + 1;
+    uint32_t ncode = get_bits(s, 4) + 4;
+    if (nlen > 286 || ndist > 30) return false;
+
+    memset(lengths, 0, 19);
+    for (uint32_t i = 0; i < ncode; i++) {
+        lengths[codelen_order[i]] = get_bits(s, 3);
+    }
+    if (!build_huffman(&s->lencode, lengths, 19)) return false;
+
+    uint32_t index = 0;
+    while (index < nlen + ndist) {
+        int sym = decode(s, &s->lencode);
+        if (s->error || sym < 0) return false;
+
+        if (sym < 16) {
+            lengths[index++] = sym;
+            continue;
+        }
+
+        uint8_t len = 0;
+        uint32_t repeat;
+        if (sym == 16) {
+            if (index == 0) return false;
+            len = lengths[index - 1];
+            repeat = 3 + get_bits(s, 2);
+        } else if (sym == 17) {
+            repeat = 3 + get_bits(s, 3);
+        } else {
+            repeat = 11 + get_bits(s, 7);
+        }
+        if (index + repeat > nlen + ndist) return false;
+        while (repeat--) lengths[index++] = len;
+    }
+
+    // The end-of-block code must be present
+    if (lengths[256] == 0) return false;
+    if (!build_huffman(&s->lencode, lengths, nlen)) return false;
+    if (!build_huffman(&s->distcode, lengths + nlen, ndist)) return false;
+
+    return inflate_codes(s);
+}
+
+static bool inflate_member(Inflater *s) {
+    uint32_t last;
+    do {
+        last = get_bits(s, 1);
+        uint32_t type = get_bits(s, 2);
+        bool ok;
+        switch (type) {
+            case 0: ok = inflate_stored(s); break;
+            case 1: ok = inflate_fixed(s); break;
+            case 2: ok = inflate_dynamic(s); break;
+            default: ok = false; break;
+        }
+        if (!ok || s->error) return false;
+    } while (!last);
+
+    // Trailer starts at the next byte boundary
+    consume(s, s->bitcnt & 7);
+    return !s->error;
+}
+
+static bool read_gzip_header(Inflater *s) {
+    uint32_t id1 = get_bits(s, 8);
+    uint32_t id2 = get_bits(s, 8);
+    uint32_t method = get_bits(s, 8);
+    uint32_t flags = get_bits(s, 8);
+    if (id1 != 0x1F || id2 != 0x8B || method != 8 || (flags & 0xE0)) return false;
+
+    // MTIME, XFL, OS
+    for (int i = 0; i < 6; i++) get_bits(s, 8);
+
+    if (flags & 0x04) { // FEXTRA
+        uint32_t xlen = get_bits(s, 16);
+        while (xlen--) get_bits(s, 8);
+    }
+    if (flags & 0x08) { // FNAME
+        while (get_bits(s, 8) != 0 && !s->error);
+    }
+    if (flags & 0x10) { // FCOMMENT
+        while (get_bits(s, 8) != 0 && !s->error);
+    }
+    if (flags & 0x02) { // FHCRC
+        get_bits(s, 16);
+    }
+    return !s->error;
+}
+
+static bool inflate_gzip(Inflater *s) {
+    crc_init();
+
+    do {
+        size_t member_start = s->out_len;
+        if (!read_gzip_header(s)) return false;
+        if (!inflate_member(s)) return false;
+
+        uint32_t crc = get_bits(s, 16);
+        crc |= get_bits(s, 16) << 16;
+        uint32_t isize = get_bits(s, 16);
+        isize |= get_bits(s, 16) << 16;
+        if (s->error) return false;
+
+        size_t member_len = s->out_len - member_start;
+        if (isize != (uint32_t)member_len) return false;
+        if (crc != crc_update(0, s->out + member_start, member_len)) return false;
+
+        // Concatenated members continue the same stream
+        refill(s);
+    } while (s->bitcnt >= 16 + s->overrun * 8 && (s->bitbuf & 0xFFFF) == 0x8B1F);
+
+    return true;
+}
+
+uint8_t* vgz_read_file(const char *filename, size_t *size) {
+    FILE *f = fopen(filename, "rb");
+    if (!f) return NULL;
+
+    Inflater *s = calloc(1, sizeof(Inflater));
+    if (!s) {
+        fclose(f);
+        return NULL;
+    }
+    s->f = f;
+
+    // The gzip trailer holds the uncompressed size, use it to size the output up front
+    long file_size = -1;
+    uint8_t magic[2] = {0, 0};
+    if (fseek(f, 0, SEEK_END) == 0) {
+        file_size = ftell(f);
+        fseek(f, 0, SEEK_SET);
+    }
+    size_t magic_len = fread(magic, 1, 2, f);
+    bool gzip = magic_len == 2 && magic[0] == 0x1F && magic[1] == 0x8B;
+
+    if (gzip && file_size >= 18 && fseek(f, -4, SEEK_END) == 0) {
+        uint8_t t[4];
+        if (fread(t, 1, 4, f) == 4) {
+            size_t isize = (size_t)t[0] | ((size_t)t[1] << 8) | ((size_t)t[2] << 16) | ((size_t)t[3] << 24);
+            if (isize <= VGZ_MAX_HINT) reserve_output(s, isize);
+        }
+    } else if (!gzip && file_size > 0) {
+        reserve_output(s, file_size);
+    }
+    fseek(f, 0, SEEK_SET);
+
+    bool ok = reserve_output(s, 1);
+    if (!ok) {
+        // Out of memory
+    } else if (gzip) {
+        ok = inflate_gzip(s);
+    } else {
+        // Plain VGM, read it as is
+        for (;;) {
+            if (!reserve_output(s, VGZ_CHUNK)) {
+                ok = false;
+                break;
+            }
+            size_t n = fread(s->out + s->out_len, 1, VGZ_CHUNK, f);
+            s->out_len += n;
+            if (n < VGZ_CHUNK) {
+                ok = !ferror(f);
+                break;
+            }
+        }
+    }
+    fclose(f);
+
+    uint8_t *out = s->out;
+    *size = s->out_len;
+    free(s);
+
+    if (!ok) {
+        free(out);
+        return NULL;
+    }
+    return out;
+}
@@ -0,0 +1,20 @@
+#ifndef VGZ_H
+#define VGZ_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Reads a whole VGM file into memory. Gzip compressed input (VGZ) is detected
+// by its magic and inflated while it is being read, so no temporary file or
+// copy of the compressed data is needed. Returns NULL on I/O or format errors.
+uint8_t* vgz_read_file(const char *filename, size_t *size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
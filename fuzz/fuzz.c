@@ -0,0 +1,359 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "renuke.h"
+#include "renuke_internal.h"
+#include "reference.h"
+
+// Differential fuzzer: runs the library engine and the reference engine (reference.c) in lockstep
+// on a random timed stream of writes, reads and TEST pin changes, and aborts as soon as their
+// mol/mor output, read results or chip state differ. With RNCM_FAST set in the chip type byte it
+// runs the fast engine against the library's cycle-accurate core instead (see run_fast).
+//
+// Built with -Dfuzzer=true it is a libFuzzer target. Otherwise it has its own main:
+//   renuke-fuzz                  Runs one input from stdin (AFL)
+//   renuke-fuzz <file>...        Runs inputs from files (reproducing crashes)
+//   renuke-fuzz -n <count> [seed] Runs random inputs
+//
+// Input format: the first byte selects the chip type (RNCM_* bits), then every byte is an operation
+// (low 3 bits) with a small argument (upper 5 bits), some followed by a data byte:
+//   0  address write, part = arg bit 1, data byte
+//   1  data write, part = arg bit 1, data byte
+//   2  clock arg + 1 cycles
+//   3  clock (byte + 1) * 8 cycles
+//   4  read port arg & 3, IRQ and TEST pins
+//   5  set TEST pin to arg & 1
+//   6  scheduled write to port arg & 3, data byte
+//   7  RN_Clock (byte + 1) * 24 cycles, dequeue and compare samples
+
+#define MAX_CYCLES (1 << 18) // Per input, keeps every input fast
+
+typedef struct
+{
+    RN_Chip *chip;
+    RN_Chip *ref;
+    uint64_t cycle;
+    size_t op_offset;
+} Pair;
+
+static void mismatch(const Pair *pair, const char *what)
+{
+    fprintf(stderr, "renuke-fuzz: %s differs at cycle %llu (input offset %zu)\n",
+        what, (unsigned long long)pair->cycle, pair->op_offset);
+    abort();
+}
+
+static void compare_state(const Pair *pair)
+{
+    if (memcmp(pair->chip, pair->ref, RN_CHIP_STATE_SIZE) == 0) return;
+
+    const uint8_t *a = (const uint8_t *)pair->chip;
+    const uint8_t *b = (const uint8_t *)pair->ref;
+    size_t offset;
+    for (offset = 0; a[offset] == b[offset]; offset++);
+
+    fprintf(stderr, "renuke-fuzz: chip state byte %zu: 0x%02x, reference 0x%02x\n", offset, a[offset], b[offset]);
+    mismatch(pair, "chip state");
+}
+
+static void clock_cycles(Pair *pair, uint32_t cycles)
+{
+    int16_t out[2], ref_out[2];
+
+    for (uint32_t i = 0; i < cycles; i++)
+    {
+        RN_Clock1(pair->chip, out);
+        RNRef_Clock1(pair->ref, ref_out);
+
+        if (out[0] != ref_out[0] || out[1] != ref_out[1]) mismatch(pair, "mol/mor");
+        compare_state(pair);
+
+        pair->cycle++;
+    }
+}
+
+static void clock_queued(Pair *pair, uint32_t cycles)
+{
+    int16_t samples[RN_SAMPLE_QUEUE_LENGTH], ref_samples[RN_SAMPLE_QUEUE_LENGTH];
+
+    RN_Clock(pair->chip, cycles);
+    RNRef_Clock(pair->ref, cycles);
+    pair->cycle += cycles;
+
+    uint32_t count = RN_DequeueSamples(pair->chip, samples, RN_SAMPLE_QUEUE_LENGTH / 2);
+    uint32_t ref_count = RNRef_DequeueSamples(pair->ref, ref_samples, RN_SAMPLE_QUEUE_LENGTH / 2);
+
+    if (count != ref_count) mismatch(pair, "queued sample count");
+    if (memcmp(samples, ref_samples, count * 2 * sizeof(int16_t)) != 0) mismatch(pair, "queued samples");
+    compare_state(pair);
+}
+
+static void clock_frames(Pair *pair, uint32_t frames)
+{
+    int16_t samples[RN_SAMPLE_QUEUE_LENGTH], accurate_samples[RN_SAMPLE_QUEUE_LENGTH];
+
+    RN_Clock(pair->chip, frames * 24);
+    RN_Clock(pair->ref, frames * 24);
+    pair->cycle += frames * 24;
+
+    uint32_t count = RN_DequeueSamples(pair->chip, samples, RN_SAMPLE_QUEUE_LENGTH / 2);
+    uint32_t accurate_count = RN_DequeueSamples(pair->ref, accurate_samples, RN_SAMPLE_QUEUE_LENGTH / 2);
+
+    if (count != accurate_count) mismatch(pair, "fast engine sample count");
+    if (memcmp(samples, accurate_samples, count * 2 * sizeof(int16_t)) != 0) mismatch(pair, "fast engine samples");
+}
+
+// The fast engine (pair.chip) against the cycle-accurate core (pair.ref), compared sample by sample.
+// Only what the fast engine promises to match is exercised: every clock is whole 24 cycle frames and
+// every write lands a frame after the previous one, on a frame boundary. The test registers, the TEST
+// pin, the busy flag and scheduled writes (which land mid-frame) are left out, the same operation
+// bytes clock a frame instead. Addresses are folded onto the register range and long clocks are
+// capped at 64 frames, so random inputs reach more register combinations.
+static void run_fast(const uint8_t *data, size_t size, RN_ChipType chip_type)
+{
+    Pair pair = {0};
+    uint8_t address[2] = {0};
+    int wrote = 0;
+    size_t pos = 1;
+
+    pair.chip = RN_Create(chip_type | RNCM_FAST);
+    pair.ref = RN_Create(chip_type);
+    if (!pair.chip || !pair.ref)
+    {
+        fprintf(stderr, "renuke-fuzz: failed to create chips\n");
+        abort();
+    }
+
+    while (pos < size && pair.cycle < MAX_CYCLES)
+    {
+        uint8_t op = data[pos];
+        uint8_t arg = op >> 3;
+        uint8_t value = pos + 1 < size ? data[pos + 1] : 0;
+
+        pair.op_offset = pos;
+        pos += 1;
+
+        switch (op & 7)
+        {
+            case 0:
+            case 1:
+            {
+                uint32_t part = (arg >> 1) & 1;
+                uint32_t port = (arg & 2) | (op & 1);
+                pos++;
+
+                if (op & 1)
+                {
+                    if (part == 0 && address[0] == 0x2C) break;
+                }
+                else
+                {
+                    value = (uint8_t)(0x22 + value % (0xB8 - 0x22));
+                    address[part] = value;
+                }
+
+                if (wrote) clock_frames(&pair, 1);
+                RN_Write(pair.chip, port, value);
+                RN_Write(pair.ref, port, value);
+                wrote = 1;
+                continue;
+            }
+            case 2:
+                clock_frames(&pair, arg + 1);
+                break;
+            case 3:
+            case 7:
+                clock_frames(&pair, (value & 63) + 1);
+                pos++;
+                break;
+            case 4:
+                if ((RN_Read(pair.chip, arg & 3) & 0x7f) != (RN_Read(pair.ref, arg & 3) & 0x7f)) mismatch(&pair, "fast engine RN_Read");
+                if (RN_ReadIRQPin(pair.chip) != RN_ReadIRQPin(pair.ref)) mismatch(&pair, "fast engine IRQ pin");
+                continue;
+            case 5:
+                clock_frames(&pair, 1);
+                break;
+            case 6:
+                clock_frames(&pair, 1);
+                pos++;
+                break;
+        }
+
+        wrote = 0;
+    }
+
+    RN_Destroy(pair.chip);
+    RN_Destroy(pair.ref);
+}
+
+static void run(const uint8_t *data, size_t size)
+{
+    if (size == 0) return;
+
+    if (data[0] & RNCM_FAST)
+    {
+        run_fast(data, size, (RN_ChipType)(data[0] & (RNCM_YM2612 | RNCM_READ_MODE)));
+        return;
+    }
+
+    RN_ChipType chip_type = (RN_ChipType)(data[0] & (RNCM_YM2612 | RNCM_READ_MODE));
+    Pair pair = {0};
+    size_t pos = 1;
+
+    pair.chip = RN_Create(chip_type);
+    pair.ref = RNRef_Create(chip_type);
+    if (!pair.chip || !pair.ref)
+    {
+        fprintf(stderr, "renuke-fuzz: failed to create chips\n");
+        abort();
+    }
+
+    compare_state(&pair);
+
+    while (pos < size && pair.cycle < MAX_CYCLES)
+    {
+        uint8_t op = data[pos];
+        uint8_t arg = op >> 3;
+        uint8_t value = pos + 1 < size ? data[pos + 1] : 0;
+
+        pair.op_offset = pos;
+        pos += 1;
+
+        switch (op & 7)
+        {
+            case 0:
+            case 1:
+            {
+                uint32_t port = (arg & 2) | (op & 1);
+                RN_Write(pair.chip, port, value);
+                RNRef_Write(pair.ref, port, value);
+                pos++;
+                break;
+            }
+            case 2:
+                clock_cycles(&pair, arg + 1);
+                break;
+            case 3:
+                clock_cycles(&pair, (value + 1) * 8);
+                pos++;
+                break;
+            case 4:
+                if (RN_Read(pair.chip, arg & 3) != RNRef_Read(pair.ref, arg & 3)) mismatch(&pair, "RN_Read");
+                if (RN_ReadIRQPin(pair.chip) != RNRef_ReadIRQPin(pair.ref)) mismatch(&pair, "IRQ pin");
+                if (RN_ReadTestPin(pair.chip) != RNRef_ReadTestPin(pair.ref)) mismatch(&pair, "TEST pin");
+                break;
+            case 5:
+                RN_SetTestPin(pair.chip, arg & 1);
+                RNRef_SetTestPin(pair.ref, arg & 1);
+                break;
+            case 6:
+                RN_ScheduleWrite(pair.chip, arg & 3, value);
+                RNRef_ScheduleWrite(pair.ref, arg & 3, value);
+                pos++;
+                break;
+            case 7:
+                clock_queued(&pair, (value + 1) * 24);
+                pos++;
+                break;
+        }
+    }
+
+    RN_Destroy(pair.chip);
+    RNRef_Destroy(pair.ref);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    run(data, size);
+    return 0;
+}
+
+#ifndef RN_LIBFUZZER
+
+static uint8_t *read_all(FILE *f, size_t *size)
+{
+    size_t capacity = 4096;
+    uint8_t *data = malloc(capacity);
+    *size = 0;
+
+    while (data)
+    {
+        *size += fread(data + *size, 1, capacity - *size, f);
+        if (*size < capacity) break;
+
+        capacity *= 2;
+        uint8_t *grown = realloc(data, capacity);
+        if (!grown) free(data);
+        data = grown;
+    }
+
+    return data;
+}
+
+// xorshift32, inputs are reproducible from the seed
+static uint32_t next_random(uint32_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc >= 3 && strcmp(argv[1], "-n") == 0)
+    {
+        uint32_t count = (uint32_t)strtoul(argv[2], NULL, 0);
+        uint32_t seed = argc >= 4 ? (uint32_t)strtoul(argv[3], NULL, 0) : 0x52654e75;
+        uint8_t data[4096];
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            uint32_t state = seed + i * 0x9E3779B9u;
+            if (state == 0) state = 1;
+
+            size_t size = 1 + next_random(&state) % sizeof(data);
+            for (size_t b = 0; b < size; b++) data[b] = (uint8_t)next_random(&state);
+
+            run(data, size);
+        }
+
+        printf("%u random inputs ok\n", count);
+        return 0;
+    }
+
+    if (argc == 1)
+    {
+        size_t size;
+        uint8_t *data = read_all(stdin, &size);
+        if (!data) return 1;
+        run(data, size);
+        free(data);
+        return 0;
+    }
+
+    for (int i = 1; i < argc; i++)
+    {
+        size_t size;
+        FILE *f = fopen(argv[i], "rb");
+        if (!f)
+        {
+            fprintf(stderr, "Failed to open %s\n", argv[i]);
+            return 1;
+        }
+
+        uint8_t *data = read_all(f, &size);
+        fclose(f);
+        if (!data) return 1;
+
+        run(data, size);
+        free(data);
+    }
+
+    return 0;
+}
+
+#endif
@@ -0,0 +1,7 @@
+/* Reference engine: src/renuke.c compiled a second time with RN_REFERENCE defined and its
+   public symbols renamed (see reference.h). Optimized paths must be compiled out under
+   RN_REFERENCE so this stays the straightforward per-cycle RN_Clock1 implementation. */
+#define RN_REFERENCE
+#define RN_REFERENCE_RENAME
+#include "reference.h"
+#include "renuke.c"
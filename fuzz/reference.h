@@ -0,0 +1,49 @@
+#ifndef RENUKE_FUZZ_REFERENCE_H
+#define RENUKE_FUZZ_REFERENCE_H
+
+/* The reference engine's public symbols carry an RNRef_ prefix so both engines link into one binary */
+#ifdef RN_REFERENCE_RENAME
+#define RN_Create RNRef_Create
+#define RN_Destroy RNRef_Destroy
+#define RN_GetRequiredSize RNRef_GetRequiredSize
+#define RN_InitInPlace RNRef_InitInPlace
+#define RN_Reset RNRef_Reset
+#define RN_Clock1 RNRef_Clock1
+#define RN_Write RNRef_Write
+#define RN_SetTestPin RNRef_SetTestPin
+#define RN_ReadTestPin RNRef_ReadTestPin
+#define RN_ReadIRQPin RNRef_ReadIRQPin
+#define RN_Read RNRef_Read
+#define RN_ScheduleWrite RNRef_ScheduleWrite
+#define RN_Clock RNRef_Clock
+#define RN_ClockCycles RNRef_ClockCycles
+#define RN_ClockStems RNRef_ClockStems
+#define RN_GetQueuedSamplesCount RNRef_GetQueuedSamplesCount
+#define RN_DequeueSamples RNRef_DequeueSamples
+#define RN_DequeueSamplesFormat RNRef_DequeueSamplesFormat
+#define RN_GetStats RNRef_GetStats
+#define RN_ResetStats RNRef_ResetStats
+#define RN_GetProfile RNRef_GetProfile
+#define RN_ResetProfile RNRef_ResetProfile
+#define RN_GetProfileStageName RNRef_GetProfileStageName
+#define RN_kernels_baseline RNRef_kernels_baseline
+#endif
+
+#include "renuke.h"
+
+#ifndef RN_REFERENCE_RENAME
+RN_Chip *RNRef_Create(RN_ChipType chip_type);
+void RNRef_Destroy(RN_Chip *chip);
+void RNRef_Clock1(RN_Chip *chip, int16_t *buffer);
+void RNRef_Write(RN_Chip *chip, uint32_t port, uint8_t data);
+void RNRef_SetTestPin(RN_Chip *chip, uint32_t value);
+uint32_t RNRef_ReadTestPin(RN_Chip *chip);
+uint32_t RNRef_ReadIRQPin(RN_Chip *chip);
+uint8_t RNRef_Read(RN_Chip *chip, uint32_t port);
+void RNRef_ScheduleWrite(RN_Chip *chip, uint32_t port, uint8_t data);
+void RNRef_Clock(RN_Chip *chip, int clock_count);
+uint32_t RNRef_GetQueuedSamplesCount(RN_Chip *chip);
+uint32_t RNRef_DequeueSamples(RN_Chip *chip, int16_t *buffer, uint32_t sample_count);
+#endif
+
+#endif
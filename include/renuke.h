@@ -7,7 +7,8 @@ extern "C" {
 
 typedef enum {
     RNCM_YM2612 = 0x01,      /* Enables YM2612 emulation (MD1, MD2 VA2) */
-    RNCM_READ_MODE = 0x02    /* Enables status read on any port (TeraDrive, MD1 VA7, MD2, etc) */
+    RNCM_READ_MODE = 0x02,   /* Enables status read on any port (TeraDrive, MD1 VA7, MD2, etc) */
+    RNCM_FAST = 0x04         /* Per-sample engine, ~3x faster, most writes land on sample boundaries (see README) */
 } RN_ChipType;
 
 #include <stdint.h>
@@ -16,6 +17,9 @@ typedef enum {
 #define RN_SAMPLE_RATE_NTSC 53267 // 53,267.03869047619Hz
 #define RN_SAMPLE_RATE_PAL  52781 // 52,781.17460317460Hz
 
+#define RN_MASTER_CLOCK_NTSC 53693175 // YM2612 = master / 7, SN76489 = master / 15
+#define RN_MASTER_CLOCK_PAL  53203424
+
 #define RN_SAMPLE_QUEUE_LENGTH 1024
 #define RN_WRITE_QUEUE_LENGTH 1024
 
@@ -36,14 +40,73 @@ typedef enum {
 #define RN_FREQ_LSB      0xA0
 #define RN_FREQ_BLOCK_MSB 0xA4
 
+typedef enum {
+    RN_REGION_NTSC = 0,
+    RN_REGION_PAL = 1
+} RN_Region;
+
 typedef struct RN_Chip RN_Chip;
+typedef struct RN_System RN_System;
+
+// Counters since creation, RN_Reset or RN_ResetStats
+typedef struct {
+    uint64_t cycles;              // Internal clock cycles run
+    uint64_t samples_produced;    // Samples added to the sample queue
+    uint64_t samples_dequeued;
+    uint32_t queue_high_water;    // Most samples queued at once
+    uint64_t queue_overruns;      // Samples added to a full queue, overwriting unread ones
+    uint64_t writes_scheduled;    // RN_ScheduleWrite calls
+    uint64_t writes_applied;      // Scheduled writes that reached the chip
+    uint64_t writes_dropped;      // RN_ScheduleWrite calls rejected by a full write queue
+    uint64_t write_stall_cycles;  // Cycles a scheduled write waited for the previous write to finish
+    uint64_t key_on_deferred;     // Key-on/off writes held back by the minimum spacing between notes
+} RN_Stats;
+
+// Pipeline stages timed in -Dprofiling=true builds
+typedef enum {
+    RN_STAGE_IO,        // RN_DoIO
+    RN_STAGE_TIMERS,    // Timer A and B
+    RN_STAGE_KEY_ON,
+    RN_STAGE_CHANNEL,   // Channel output and accumulation
+    RN_STAGE_FM,        // Operator modulation and output
+    RN_STAGE_PHASE,     // Phase generator
+    RN_STAGE_ENVELOPE,  // Envelope generator and SSG-EG
+    RN_STAGE_LFO,
+    RN_STAGE_REG_WRITE, // Register decode
+    RN_STAGE_SCHEDULER, // RN_ScheduleWrite queue, in RN_Clock
+    RN_STAGE_OTHER,     // Per-cycle bookkeeping between the stages
+    RN_STAGE_COUNT
+} RN_ProfileStage;
+
+// Ticks are TSC cycles on x86 and nanoseconds elsewhere
+typedef struct {
+    uint64_t cycles;                 // RN_Clock1 calls
+    uint64_t ticks[RN_STAGE_COUNT];
+} RN_Profile;
 
 RN_Chip* RN_Create(RN_ChipType chip_type);
 void RN_Destroy(RN_Chip *chip);
 
+// In-place initialization: the chip and both queues in one caller-supplied block of RN_GetRequiredSize bytes,
+// aligned to at least RN_CHIP_ALIGNMENT, which the chip's own fields need. The queues start at 64 byte offsets
+// into the block, so 64 byte alignment also keeps them on their own cache lines. Returns NULL when the block is
+// misaligned or the configuration invalid, RN_GetRequiredSize returns 0 for the latter.
+// RN_Destroy ends traces and pin dumps of such a chip and leaves the memory to the caller.
+#define RN_CHIP_ALIGNMENT 8
+typedef struct
+{
+    RN_ChipType chip_type;
+    uint32_t sample_queue_length; // int16 values (2 per sample) like RN_SAMPLE_QUEUE_LENGTH, a power of two, 0 for that
+    uint32_t write_queue_length;  // Scheduled writes, a power of two, 0 for RN_WRITE_QUEUE_LENGTH
+} RN_Config;
+size_t RN_GetRequiredSize(const RN_Config *config);
+RN_Chip* RN_InitInPlace(void *memory, const RN_Config *config);
+
 void RN_Reset(RN_Chip *chip);
 void RN_Write(RN_Chip *chip, uint32_t port, uint8_t data);
 void RN_Clock(RN_Chip *chip, int clock_count);
+// Runs a single internal clock cycle, buffer receives that cycle's raw left/right output (mol/mor)
+void RN_Clock1(RN_Chip *chip, int16_t *buffer);
 void RN_SetTestPin(RN_Chip *chip, uint32_t value);
 uint32_t RN_ReadTestPin(RN_Chip *chip);
 uint32_t RN_ReadIRQPin(RN_Chip *chip);
@@ -52,9 +115,138 @@ uint8_t RN_Read(RN_Chip *chip, uint32_t port);
 uint32_t RN_GetQueuedSamplesCount(RN_Chip* chip);
 uint32_t RN_DequeueSamples(RN_Chip* chip, int16_t* buffer, uint32_t sample_count);
 
+// Output formats of RN_DequeueSamplesFormat, RN_DequeueSamples is RN_FORMAT_S16. Interleaved unless
+// RN_FORMAT_PLANAR is or'ed in, which writes the left channel to buffer and the right one to right.
+typedef enum {
+    RN_FORMAT_S16 = 0,       // int16, clamped
+    RN_FORMAT_S32 = 1,       // int32 at the int16 scale, not clamped, for summing chips with headroom
+    RN_FORMAT_F32 = 2,       // float, 1.0 = int16 full scale, not clamped
+    RN_FORMAT_PLANAR = 0x10
+} RN_SampleFormat;
+uint32_t RN_DequeueSamplesFormat(RN_Chip *chip, RN_SampleFormat format, void *buffer, void *right, uint32_t sample_count);
+
+// Stems: RN_ClockStems clocks like RN_Clock, the mix still goes to the sample queue, and also writes every
+// finished sample of each channel to its own buffer. stems holds RN_STEM_COUNT buffers, or left/right pairs of
+// them with RN_FORMAT_PLANAR, of at least clock_count / 24 + 1 samples each. Before clamping the stems add up
+// to the mix, except that with the cycle-accurate core a sample started with RN_Clock only has the cycles
+// clocked by RN_ClockStems in its stems. Returns the number of samples written to every stem.
+#define RN_STEM_COUNT 7 // Channels 1 to 6, then the DAC, which replaces channel 6 while enabled
+uint32_t RN_ClockStems(RN_Chip *chip, int clock_count, RN_SampleFormat format, void *const *stems);
+
+// Resampler: windowed-sinc polyphase conversion of interleaved stereo samples, e.g. from the chip rate to the
+// host's 44.1 or 48 kHz. The filter bank is computed for the rate ratio at creation. RN_ResamplerProcess takes
+// RN_FORMAT_S16, S32 or F32 input and output (not planar), consumes what fits its history and writes up to
+// out_count samples, and sets both counts to what it did. RN_ResamplerInputNeeded returns the input samples
+// still needed for out_count more output samples. Output n is taken at input time n * in_rate / out_rate, so
+// it waits for half the taps of input past that point.
+typedef struct RN_Resampler RN_Resampler;
+typedef enum {
+    RN_RESAMPLE_FAST = 0,   // 16 taps, flat to 85% of the lower Nyquist frequency
+    RN_RESAMPLE_MEDIUM = 1, // 32 taps, 91%
+    RN_RESAMPLE_BEST = 2    // 64 taps, 95%
+} RN_ResampleQuality;
+RN_Resampler* RN_ResamplerCreate(double in_rate, double out_rate, RN_ResampleQuality quality);
+void RN_ResamplerDestroy(RN_Resampler *resampler);
+void RN_ResamplerReset(RN_Resampler *resampler);
+void RN_ResamplerProcess(RN_Resampler *resampler, RN_SampleFormat format, const void *in, uint32_t *in_count, void *out, uint32_t *out_count);
+uint32_t RN_ResamplerInputNeeded(RN_Resampler *resampler, uint32_t out_count);
+// Clocks the chip as needed and resamples its output, always writes sample_count samples
+void RN_RenderResampled(RN_Chip *chip, RN_Resampler *resampler, RN_SampleFormat format, void *buffer, uint32_t sample_count);
+
+// Decimator: filters every cycle's output (24 per sample, ~1.28 MHz) straight down to out_rate, rather than
+// summing each sample's 24 cycles first, so writes between sample boundaries keep their timing. A 4th order
+// CIC filter to 4x the sample rate, then the resampler with its taps scaled by the remaining ratio. sample_rate
+// is the chip's, e.g. RN_MASTER_CLOCK_NTSC / 1008.0. Sample n is at the same time as with RN_RenderResampled,
+// but each channel keeps its own cycles within it. The response is about 0.5 dB down at 20 kHz. With
+// RNCM_FAST each cycle is the frame average, as with RN_Clock1.
+typedef struct RN_Decimator RN_Decimator;
+RN_Decimator* RN_DecimatorCreate(double sample_rate, double out_rate, RN_ResampleQuality quality);
+void RN_DecimatorDestroy(RN_Decimator *decimator);
+void RN_DecimatorReset(RN_Decimator *decimator);
+// Clocks the chip as needed and writes sample_count samples, nothing goes to the sample queue
+void RN_RenderDecimated(RN_Chip *chip, RN_Decimator *decimator, RN_SampleFormat format, void *buffer, uint32_t sample_count);
+
+// Output filter: the analog high-pass and low-pass stages after the chip on a console, as IIR sections designed
+// for sample_rate. RN_OutputFilterProcess filters a buffer in place in any RN_SampleFormat (right is the right
+// channel of planar ones), after RN_DequeueSamplesFormat at the chip rate or RN_RenderResampled at the host rate.
+typedef struct RN_OutputFilter RN_OutputFilter;
+typedef enum {
+    RN_MODEL_MD1 = 0,       // Model 1, RNCM_YM2612: DC block and a 1st order low-pass at 3.4 kHz
+    RN_MODEL_MD2 = 1,       // Model 2, RNCM_YM2612 or RNCM_READ_MODE: DC block and a 2nd order low-pass at 15 kHz
+    RN_MODEL_TERADRIVE = 2  // RNCM_READ_MODE: DC block and a 1st order low-pass at 22 kHz
+} RN_ConsoleModel;
+RN_OutputFilter* RN_OutputFilterCreate(RN_ConsoleModel model, double sample_rate);
+void RN_OutputFilterDestroy(RN_OutputFilter *filter);
+void RN_OutputFilterReset(RN_OutputFilter *filter);
+void RN_OutputFilterProcess(RN_OutputFilter *filter, RN_SampleFormat format, void *buffer, void *right, uint32_t sample_count);
+
 // Schedules a write after waiting for the last write to finish
 void RN_ScheduleWrite(RN_Chip* chip, uint32_t port, uint8_t data);
 
+void RN_GetStats(RN_Chip *chip, RN_Stats *stats);
+void RN_ResetStats(RN_Chip *chip);
+
+// ISA level of the clock paths picked at RN_Create: "baseline", "avx2" or "avx512". The best level the CPU
+// supports is used unless the RENUKE_ISA environment variable names a lower one.
+const char* RN_GetISA(RN_Chip *chip);
+
+// Write trace: records RN_Write, RN_ScheduleWrite, RN_Read, RN_SetTestPin and RN_Reset calls, and the clock and
+// dequeue calls between them, after a snapshot of the chip state. RN_TraceReplay reproduces the run exactly
+// with the same library version; it returns the number of reads that differed from the recording, or -1.
+#define RN_TRACE_MMAP 0x01 // Write through a growing mmap'd window instead of a buffered file (POSIX only)
+typedef void (*RN_TraceSamples)(void *userdata, const int16_t *samples, uint32_t sample_count);
+int RN_TraceBegin(RN_Chip *chip, const char *path, uint32_t flags); // 0 on success, -1 on failure
+int RN_TraceEnd(RN_Chip *chip);
+int RN_TraceReplay(const char *path, RN_TraceSamples on_samples, void *userdata);
+
+// Pin dump: streams the raw per-cycle mol/mor pairs of RN_Clock and RN_Clock1 (int16, native endian, no header)
+// into a file preallocated and memory-mapped for cycle_count cycles, dumping stops once it is full. POSIX only.
+int RN_PinDumpBegin(RN_Chip *chip, const char *path, uint64_t cycle_count); // 0 on success, -1 on failure
+uint64_t RN_PinDumpEnd(RN_Chip *chip); // Truncates the file to the dumped cycles and returns their count, 0 on failure
+
+// Taps for visualizers: while they are on, RN_Clock (and so RN_RenderResampled) writes every decimation-th
+// sample of each channel and the envelopes of all slots to a ring of RN_TAP_FRAMES frames. Another thread
+// reads them without locks, oldest first from its own cursor, and frames overwritten before it got to them are
+// skipped. Start the cursor at RN_TapsPosition less the frame count for the newest frames only. RN_TapsEnd
+// frees the ring, the reader has to be done with it. With taps off, RN_Clock checks for them once per call.
+#define RN_TAP_FRAMES 1024
+typedef struct {
+    int16_t channels[RN_STEM_COUNT]; // Each stem at the int16 scale, (left + right) / 2, clamped on its own
+    uint16_t eg_out[24];             // Envelope attenuation, 0 loudest to 0x3ff silent, of slot op * 6 + channel
+                                     // with op in register order (0x30, 0x34, 0x38, 0x3C: operators 1, 3, 2, 4)
+} RN_TapFrame;
+typedef struct RN_Taps RN_Taps;
+RN_Taps* RN_TapsBegin(RN_Chip *chip, uint32_t decimation); // NULL on failure, ends taps already on
+void RN_TapsEnd(RN_Chip *chip);
+uint32_t RN_TapsPosition(RN_Taps *taps); // Frames written so far
+uint32_t RN_TapsRead(RN_Taps *taps, uint32_t *cursor, RN_TapFrame *frames, uint32_t frame_count); // Returns the frames read
+
+// Per-stage totals since creation, RN_Reset or RN_ResetProfile. Returns 0 (and a zeroed profile)
+// unless the library was built with -Dprofiling=true
+int RN_GetProfile(RN_Chip *chip, RN_Profile *profile);
+void RN_ResetProfile(RN_Chip *chip);
+const char* RN_GetProfileStageName(RN_ProfileStage stage);
+
+// Mega Drive audio: YM2612/YM3438 and SN76489 PSG on one master clock, mixed to one output
+// psg_clock is the SN76489 input clock in Hz, 0 derives it from the master clock (master / 15)
+RN_System* RN_SystemCreate(RN_ChipType chip_type, RN_Region region, uint32_t psg_clock);
+void RN_SystemDestroy(RN_System *system);
+void RN_SystemReset(RN_System *system);
+RN_Chip* RN_SystemGetChip(RN_System *system);
+uint32_t RN_SystemGetMasterClock(RN_System *system);
+
+// Writes land at the current point of the shared timeline, YM2612 writes are scheduled like RN_ScheduleWrite
+void RN_SystemWriteYM(RN_System *system, uint32_t port, uint8_t data);
+void RN_SystemWritePSG(RN_System *system, uint8_t data);
+void RN_SystemWritePSGStereo(RN_System *system, uint8_t data);
+
+// Advances both chips by YM2612 internal clock cycles (42 master clocks each)
+void RN_SystemClock(RN_System *system, int clock_count);
+uint32_t RN_SystemGetQueuedSamplesCount(RN_System *system);
+uint32_t RN_SystemDequeueSamples(RN_System *system, int16_t *buffer, uint32_t sample_count);
+// Dequeues from several systems (eg. dual chip setups) at once, summing them before a single clamp
+uint32_t RN_SystemDequeueMixed(RN_System *const *systems, uint32_t system_count, int16_t *buffer, uint32_t sample_count);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,421 @@
+#ifndef RENUKE_HPP
+#define RENUKE_HPP
+
+// C++17 wrapper around the C API, header only. renuke::Chip owns an RN_Chip, is move-only and has no
+// virtuals, so a host that inlines it pays nothing over calling the C functions directly. With C++20
+// the buffer overloads also take std::span. renuke::ChipPool recycles in-place chips from a
+// std::pmr::memory_resource.
+//
+//   renuke::Chip<renuke::Model::YM2612> chip;
+//   chip.write_register(0, RN_KEYONOFF, 0xF0);
+//   chip.render(buffer); // Interleaved stereo samples
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include "renuke.h"
+
+#if __cplusplus >= 202002L && defined(__has_include)
+#if __has_include(<span>)
+#include <span>
+#define RENUKE_HAVE_SPAN 1
+#endif
+#endif
+
+#if defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#include <vector>
+#define RENUKE_HAVE_PMR 1
+#endif
+#endif
+
+namespace renuke
+{
+
+enum class Model : unsigned
+{
+    YM3438 = 0,
+    YM2612 = RNCM_YM2612
+};
+
+// Options, or'ed into the second template parameter of Chip
+constexpr unsigned ReadMode = RNCM_READ_MODE;
+constexpr unsigned Fast = RNCM_FAST;
+
+// A port write for the batch APIs, port as in RN_Write
+struct Write
+{
+    uint32_t port;
+    uint8_t data;
+};
+
+// A register write for the batch APIs, part 0 for registers 0x00-0xFF, 1 for 0x100-0x1FF
+struct RegisterWrite
+{
+    uint8_t part;
+    uint8_t address;
+    uint8_t data;
+};
+
+// The operations of Chip and ChipPool::Handle. The chip type is a template parameter, fixed when the
+// chip is created. This only saves passing it around, the clock loop in the C library still selects the
+// YM2612 or YM3438 output per cycle.
+template <Model M, unsigned Options>
+class ChipBase
+{
+public:
+    static constexpr RN_ChipType type = static_cast<RN_ChipType>(static_cast<unsigned>(M) | Options);
+
+    // The C handle, for the parts of the API not wrapped here
+    RN_Chip *get() const noexcept
+    {
+        return chip_;
+    }
+
+    void reset()
+    {
+        RN_Reset(chip_);
+    }
+
+    // Immediate port write (RN_Write) and port read (RN_Read)
+    void write(uint32_t port, uint8_t data)
+    {
+        RN_Write(chip_, port, data);
+    }
+
+    uint8_t read(uint32_t port)
+    {
+        return RN_Read(chip_, port);
+    }
+
+    // Scheduled writes (RN_ScheduleWrite), applied with the chip's write timing while clocking
+    void schedule(uint32_t port, uint8_t data)
+    {
+        RN_ScheduleWrite(chip_, port, data);
+    }
+
+    void schedule(const Write &write)
+    {
+        RN_ScheduleWrite(chip_, write.port, write.data);
+    }
+
+    void schedule(const RegisterWrite &write)
+    {
+        write_register(write.part, write.address, write.data);
+    }
+
+    // Any iterator range or container of Write or RegisterWrite
+    template <typename Iterator, typename = decltype(*std::declval<Iterator &>())>
+    void schedule(Iterator first, Iterator last)
+    {
+        for (; first != last; ++first) schedule(*first);
+    }
+
+    template <typename Range>
+    auto schedule(const Range &writes) -> decltype(std::begin(writes), std::end(writes), void())
+    {
+        schedule(std::begin(writes), std::end(writes));
+    }
+
+    // Schedules the address and data writes of one register
+    void write_register(uint8_t part, uint8_t address, uint8_t data)
+    {
+        RN_ScheduleWrite(chip_, part ? 2 : 0, address);
+        RN_ScheduleWrite(chip_, part ? 3 : 1, data);
+    }
+
+    void clock(int cycles)
+    {
+        RN_Clock(chip_, cycles);
+    }
+
+    // One internal cycle, returns its raw mol/mor output
+    std::pair<int16_t, int16_t> clock1()
+    {
+        int16_t buffer[2];
+        RN_Clock1(chip_, buffer);
+        return { buffer[0], buffer[1] };
+    }
+
+    std::size_t queued() const
+    {
+        return RN_GetQueuedSamplesCount(chip_);
+    }
+
+    // Dequeues up to sample_count already clocked samples, returns the number dequeued
+    std::size_t dequeue(int16_t *buffer, std::size_t sample_count)
+    {
+        return RN_DequeueSamples(chip_, buffer, static_cast<uint32_t>(sample_count));
+    }
+
+    // Dequeues in another output format (RN_DequeueSamplesFormat), right is the right plane with RN_FORMAT_PLANAR
+    std::size_t dequeue(RN_SampleFormat format, void *buffer, void *right, std::size_t sample_count)
+    {
+        return RN_DequeueSamplesFormat(chip_, format, buffer, right, static_cast<uint32_t>(sample_count));
+    }
+
+    std::size_t dequeue(int32_t *buffer, std::size_t sample_count)
+    {
+        return dequeue(RN_FORMAT_S32, buffer, nullptr, sample_count);
+    }
+
+    std::size_t dequeue(float *buffer, std::size_t sample_count)
+    {
+        return dequeue(RN_FORMAT_F32, buffer, nullptr, sample_count);
+    }
+
+    std::size_t dequeue(float *left, float *right, std::size_t sample_count)
+    {
+        return dequeue(static_cast<RN_SampleFormat>(RN_FORMAT_F32 | RN_FORMAT_PLANAR), left, right, sample_count);
+    }
+
+    // Clocks like clock() and writes the finished samples of each channel to its stem (RN_ClockStems), stems
+    // holds RN_STEM_COUNT buffers, left/right pairs of them with RN_FORMAT_PLANAR
+    std::size_t clock_stems(int cycles, RN_SampleFormat format, void *const *stems)
+    {
+        return RN_ClockStems(chip_, cycles, format, stems);
+    }
+
+    template <typename Sample>
+    std::size_t clock_stems(int cycles, Sample *const (&stems)[RN_STEM_COUNT])
+    {
+        void *buffers[RN_STEM_COUNT];
+        for (int stem = 0; stem < RN_STEM_COUNT; stem++) buffers[stem] = stems[stem];
+        return clock_stems(cycles, format_of(stems[0]), buffers);
+    }
+
+    // Clocks and dequeues exactly sample_count interleaved stereo samples, queued samples come first
+    std::size_t render(int16_t *buffer, std::size_t sample_count)
+    {
+        std::size_t done = 0;
+        while (done < sample_count)
+        {
+            std::size_t wanted = sample_count - done;
+            std::size_t queued_now = queued();
+            if (queued_now < wanted)
+            {
+                std::size_t missing = wanted - queued_now;
+                std::size_t room = max_queued_samples_ - queued_now;
+                RN_Clock(chip_, static_cast<int>((missing < room ? missing : room) * 24));
+            }
+            done += dequeue(buffer + done * 2, wanted < max_queued_samples_ ? wanted : max_queued_samples_);
+        }
+        return done;
+    }
+
+#ifdef RENUKE_HAVE_SPAN
+    // Span overloads, the size is in int16 values (2 per stereo sample)
+    std::size_t dequeue(std::span<int16_t> buffer)
+    {
+        return dequeue(buffer.data(), buffer.size() / 2);
+    }
+
+    std::size_t render(std::span<int16_t> buffer)
+    {
+        return render(buffer.data(), buffer.size() / 2);
+    }
+
+    void schedule(std::span<const Write> writes)
+    {
+        schedule(writes.begin(), writes.end());
+    }
+
+    void schedule(std::span<const RegisterWrite> writes)
+    {
+        schedule(writes.begin(), writes.end());
+    }
+#endif
+
+protected:
+    static constexpr RN_SampleFormat format_of(int16_t *)
+    {
+        return RN_FORMAT_S16;
+    }
+
+    static constexpr RN_SampleFormat format_of(int32_t *)
+    {
+        return RN_FORMAT_S32;
+    }
+
+    static constexpr RN_SampleFormat format_of(float *)
+    {
+        return RN_FORMAT_F32;
+    }
+
+    ChipBase(RN_Chip *chip, std::size_t max_queued_samples) noexcept : chip_(chip), max_queued_samples_(max_queued_samples)
+    {
+    }
+
+    ~ChipBase() = default;
+
+    RN_Chip *chip_;
+    std::size_t max_queued_samples_; // Sample queue capacity in stereo samples
+};
+
+// A chip of its own from RN_Create
+template <Model M, unsigned Options = 0>
+class Chip : public ChipBase<M, Options>
+{
+public:
+    Chip() : ChipBase<M, Options>(RN_Create(Chip::type), RN_SAMPLE_QUEUE_LENGTH / 2)
+    {
+        if (!this->chip_) throw std::bad_alloc();
+    }
+
+    ~Chip()
+    {
+        RN_Destroy(this->chip_);
+    }
+
+    Chip(Chip &&other) noexcept : ChipBase<M, Options>(std::exchange(other.chip_, nullptr), other.max_queued_samples_)
+    {
+    }
+
+    Chip &operator=(Chip &&other) noexcept
+    {
+        if (this != &other)
+        {
+            RN_Destroy(this->chip_);
+            this->chip_ = std::exchange(other.chip_, nullptr);
+        }
+        return *this;
+    }
+
+    Chip(const Chip &) = delete;
+    Chip &operator=(const Chip &) = delete;
+};
+
+using YM2612 = Chip<Model::YM2612>;
+using YM3438 = Chip<Model::YM3438>;
+
+#ifdef RENUKE_HAVE_PMR
+// Chips and their queues in RN_InitInPlace blocks from a memory resource, e.g. a monotonic or pool
+// resource per render job. Released chips go back on a free list and acquire() hands them out again
+// after an RN_Reset, so a pool that has grown to its peak chip count allocates nothing more.
+// Not thread safe, and handles have to be released before the pool is destroyed.
+template <Model M, unsigned Options = 0>
+class ChipPool
+{
+public:
+    static constexpr RN_ChipType type = ChipBase<M, Options>::type;
+    static constexpr std::size_t alignment = 64; // Queues on their own cache lines
+
+    // A pooled chip, returned to its pool when destroyed
+    class Handle : public ChipBase<M, Options>
+    {
+    public:
+        ~Handle()
+        {
+            if (this->chip_) pool_->release(this->chip_);
+        }
+
+        Handle(Handle &&other) noexcept
+            : ChipBase<M, Options>(std::exchange(other.chip_, nullptr), other.max_queued_samples_), pool_(other.pool_)
+        {
+        }
+
+        Handle &operator=(Handle &&other) noexcept
+        {
+            if (this != &other)
+            {
+                if (this->chip_) pool_->release(this->chip_);
+                this->chip_ = std::exchange(other.chip_, nullptr);
+                this->max_queued_samples_ = other.max_queued_samples_;
+                pool_ = other.pool_;
+            }
+            return *this;
+        }
+
+        Handle(const Handle &) = delete;
+        Handle &operator=(const Handle &) = delete;
+
+    private:
+        friend class ChipPool;
+
+        Handle(ChipPool *pool, RN_Chip *chip) noexcept
+            : ChipBase<M, Options>(chip, pool->config_.sample_queue_length / 2), pool_(pool)
+        {
+        }
+
+        ChipPool *pool_;
+    };
+
+    // Queue lengths as in RN_Config, 0 for the defaults
+    explicit ChipPool(std::pmr::memory_resource *resource = std::pmr::get_default_resource(),
+        uint32_t sample_queue_length = 0, uint32_t write_queue_length = 0)
+        : config_{ type, sample_queue_length ? sample_queue_length : RN_SAMPLE_QUEUE_LENGTH,
+            write_queue_length ? write_queue_length : RN_WRITE_QUEUE_LENGTH },
+          block_size_(RN_GetRequiredSize(&config_)), resource_(resource), free_(resource)
+    {
+        if (block_size_ == 0) throw std::invalid_argument("renuke::ChipPool: queue lengths must be powers of two");
+    }
+
+    ~ChipPool()
+    {
+        for (RN_Chip *chip : free_) resource_->deallocate(chip, block_size_, alignment);
+    }
+
+    ChipPool(const ChipPool &) = delete;
+    ChipPool &operator=(const ChipPool &) = delete;
+
+    Handle acquire()
+    {
+        if (free_.empty()) reserve(allocated_ + 1);
+
+        RN_Chip *chip = free_.back();
+        free_.pop_back();
+        RN_Reset(chip);
+        return Handle(this, chip);
+    }
+
+    // Grows the pool to at least chip_count chips up front
+    void reserve(std::size_t chip_count)
+    {
+        // The free list always has room for every chip, so release() never allocates
+        if (free_.capacity() < chip_count) free_.reserve(chip_count > free_.capacity() * 2 ? chip_count : free_.capacity() * 2);
+
+        while (allocated_ < chip_count)
+        {
+            void *memory = resource_->allocate(block_size_, alignment);
+            free_.push_back(RN_InitInPlace(memory, &config_));
+            allocated_++;
+        }
+    }
+
+    std::size_t allocated() const noexcept
+    {
+        return allocated_;
+    }
+
+    std::size_t available() const noexcept
+    {
+        return free_.size();
+    }
+
+    std::pmr::memory_resource *resource() const noexcept
+    {
+        return resource_;
+    }
+
+private:
+    void release(RN_Chip *chip) noexcept
+    {
+        RN_Destroy(chip); // Ends traces and pin dumps, leaves the block to the pool
+        free_.push_back(chip);
+    }
+
+    RN_Config config_;
+    std::size_t block_size_;
+    std::size_t allocated_ = 0;
+    std::pmr::memory_resource *resource_;
+    std::pmr::vector<RN_Chip *> free_;
+};
+#endif
+
+}
+
+#endif
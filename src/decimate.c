@@ -0,0 +1,120 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "renuke.h"
+#include "renuke_internal.h"
+
+/* Decimator for RN_RenderDecimated. The per-cycle output goes through a CIC filter (RN_CIC_ORDER cascaded
+   moving sums of RN_CIC_RATIO cycles) down to 4 times the sample rate, then through a windowed-sinc
+   resampler to the output rate, whose taps are scaled by the remaining ratio. Both stages run a block of
+   at most RN_RESAMPLE_BLOCK CIC outputs at a time, so the cycles are never buffered for longer. */
+
+#define RN_CIC_ORDER 4
+#define RN_CIC_RATIO 6 /* Cycles per CIC output */
+#define RN_CIC_GAIN (RN_CIC_RATIO * RN_CIC_RATIO * RN_CIC_RATIO * RN_CIC_RATIO)
+
+/* CIC output j is centred on cycle 6j + 5 - 10 (its last cycle less half the 21 cycle response), queue sample
+   k on cycle 24k + 11.5. Starting the resampler (11.5 + 5) / 6 = 2.75 CIC outputs in, 32.32 fixed point, lines
+   the output up with RN_RenderResampled. */
+#define RN_CIC_ALIGNMENT ((uint64_t)11 << 30)
+
+struct RN_Decimator
+{
+    RN_Resampler *resampler;
+    uint32_t integrator[2][RN_CIC_ORDER]; /* Wrap around, the differences of the combs come out right anyway */
+    uint32_t comb[2][RN_CIC_ORDER];
+};
+
+RN_Decimator *RN_DecimatorCreate(double sample_rate, double out_rate, RN_ResampleQuality quality)
+{
+    RN_Decimator *decimator;
+    double cic_rate = sample_rate * 24 / RN_CIC_RATIO;
+
+    if(!(sample_rate > 0.0) || !(out_rate > 0.0)) return NULL;
+
+    decimator = calloc(1, sizeof(RN_Decimator));
+    if(decimator == NULL) return NULL;
+
+    decimator->resampler = RN_ResamplerCreateScaled(cic_rate, out_rate, quality, (uint32_t)ceil(cic_rate / out_rate));
+    if(decimator->resampler == NULL)
+    {
+        free(decimator);
+        return NULL;
+    }
+
+    RN_DecimatorReset(decimator);
+    return decimator;
+}
+
+void RN_DecimatorDestroy(RN_Decimator *decimator)
+{
+    if(decimator == NULL) return;
+
+    RN_ResamplerDestroy(decimator->resampler);
+    free(decimator);
+}
+
+void RN_DecimatorReset(RN_Decimator *decimator)
+{
+    memset(decimator->integrator, 0, sizeof(decimator->integrator));
+    memset(decimator->comb, 0, sizeof(decimator->comb));
+    RN_ResamplerReset(decimator->resampler);
+    decimator->resampler->position = RN_CIC_ALIGNMENT;
+}
+
+/* Filters count x RN_CIC_RATIO cycles into count interleaved outputs, as floats of RN_FORMAT_F32 */
+static void RN_DecimatorCIC(RN_Decimator *decimator, const int16_t *cycles, uint32_t count, float *out)
+{
+    const float scale = 24.0f * RN_GAIN / RN_CIC_GAIN / 32768.0f;
+
+    for(uint32_t c = 0; c < 2; c++)
+    {
+        uint32_t *integrator = decimator->integrator[c];
+        uint32_t *comb = decimator->comb[c];
+
+        for(uint32_t i = 0; i < count; i++)
+        {
+            const int16_t *in = cycles + i * RN_CIC_RATIO * 2 + c;
+            uint32_t value;
+
+            for(uint32_t cycle = 0; cycle < RN_CIC_RATIO; cycle++)
+            {
+                value = (uint32_t)(int32_t)in[cycle * 2];
+                for(uint32_t stage = 0; stage < RN_CIC_ORDER; stage++) value = integrator[stage] += value;
+            }
+
+            for(uint32_t stage = 0; stage < RN_CIC_ORDER; stage++)
+            {
+                uint32_t previous = comb[stage];
+                comb[stage] = value;
+                value -= previous;
+            }
+
+            out[i * 2 + c] = (float)(int32_t)value * scale;
+        }
+    }
+}
+
+void RN_RenderDecimated(RN_Chip *chip, RN_Decimator *decimator, RN_SampleFormat format, void *buffer, uint32_t sample_count)
+{
+    size_t sample_size = (format & ~RN_FORMAT_PLANAR) == RN_FORMAT_S16 ? 2 * sizeof(int16_t) : 2 * sizeof(float);
+    int16_t cycles[RN_RESAMPLE_BLOCK * RN_CIC_RATIO * 2];
+    float in[RN_RESAMPLE_BLOCK * 2];
+    uint32_t done = 0;
+
+    while(done < sample_count)
+    {
+        uint32_t needed = RN_ResamplerInputNeeded(decimator->resampler, sample_count - done);
+        uint32_t out_count = sample_count - done;
+
+        if(needed > RN_RESAMPLE_BLOCK) needed = RN_RESAMPLE_BLOCK;
+        if(needed > 0)
+        {
+            RN_ClockCycles(chip, (int)(needed * RN_CIC_RATIO), cycles);
+            RN_DecimatorCIC(decimator, cycles, needed, in);
+        }
+
+        RN_ResamplerRun(decimator->resampler, RN_FORMAT_F32, in, &needed, format, (uint8_t *)buffer + done * sample_size, &out_count);
+        done += out_count;
+    }
+}
@@ -0,0 +1,50 @@
+#include <stdlib.h>
+#include <string.h>
+#include "renuke.h"
+#include "renuke_internal.h"
+
+/* Picks the clock paths for this CPU once per chip. The levels are only built for x86 with GCC or Clang
+   (RN_HAVE_AVX2 and RN_HAVE_AVX512 from meson.build), elsewhere every chip runs the baseline build. */
+
+const RN_Kernels *RN_SelectKernels(void)
+{
+    const RN_Kernels *supported[3];
+    size_t count = 0;
+    const char *forced = getenv("RENUKE_ISA");
+
+    supported[count++] = &RN_kernels_baseline;
+
+#if defined(RN_HAVE_AVX2) || defined(RN_HAVE_AVX512)
+    __builtin_cpu_init();
+#endif
+#ifdef RN_HAVE_AVX2
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi2") && __builtin_cpu_supports("fma"))
+    {
+        supported[count++] = &RN_kernels_avx2;
+
+#ifdef RN_HAVE_AVX512
+        if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+            __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512vl"))
+        {
+            supported[count++] = &RN_kernels_avx512;
+        }
+#endif
+    }
+#endif
+
+    /* A forced level this build or CPU lacks falls back to the best supported one */
+    if(forced != NULL)
+    {
+        for(size_t i = 0; i < count; i++)
+        {
+            if(strcmp(supported[i]->name, forced) == 0) return supported[i];
+        }
+    }
+
+    return supported[count - 1];
+}
+
+const char *RN_GetISA(RN_Chip *chip)
+{
+    return chip->kernels->name;
+}
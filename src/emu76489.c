@@ -8,6 +8,7 @@
   2004 06-07 : Version 1.20 -- Improved the noise emulation.
   2015 12-13 : Version 1.21 -- Changed own integer types to C99 stdint.h types.
   2016 09-06 : Version 1.22 -- Support per-channel output.
+  2026 10-18 : Version 1.23 -- Added SNG_calc_block().
 
   References: 
     SN76489 data sheet   
@@ -296,6 +297,129 @@ SNG_calc_stereo (SNG *sng, int32_t out[2])
   return;
 }
 
+void
+SNG_calc_block (SNG *sng, int32_t *out, uint32_t frames)
+{
+  /* Same as calling SNG_calc_stereo() for every frame, with the generator
+     state held in locals so the loop runs without touching memory */
+  uint32_t base_count = sng->base_count;
+  uint32_t base_incr = sng->base_incr;
+  uint32_t quality = sng->quality;
+  uint32_t sngtime = sng->sngtime;
+  uint32_t sngstep = sng->sngstep;
+  uint32_t realstep = sng->realstep;
+
+  uint32_t count0 = sng->count[0], count1 = sng->count[1], count2 = sng->count[2];
+  uint32_t edge0 = sng->edge[0], edge1 = sng->edge[1], edge2 = sng->edge[2];
+  uint32_t freq0 = sng->freq[0], freq1 = sng->freq[1], freq2 = sng->freq[2];
+  int32_t amp0 = sng->mute[0] ? 0 : (int32_t) voltbl[sng->volume[0]] << 4;
+  int32_t amp1 = sng->mute[1] ? 0 : (int32_t) voltbl[sng->volume[1]] << 4;
+  int32_t amp2 = sng->mute[2] ? 0 : (int32_t) voltbl[sng->volume[2]] << 4;
+
+  uint32_t noise_seed = sng->noise_seed;
+  uint32_t noise_count = sng->noise_count;
+  uint32_t noise_period = sng->noise_fref ? freq2 : sng->noise_freq;
+  uint32_t noise_mode = sng->noise_mode;
+  int32_t noise_amp = (int32_t) voltbl[sng->noise_volume] << 4;
+
+  int32_t out0 = sng->ch_out[0], out1 = sng->ch_out[1], out2 = sng->ch_out[2], out3 = sng->ch_out[3];
+
+  /* Stereo enables as all-ones/zero masks */
+  int32_t l0 = -(int32_t) ((sng->stereo >> 4) & 1), r0 = -(int32_t) (sng->stereo & 1);
+  int32_t l1 = -(int32_t) ((sng->stereo >> 5) & 1), r1 = -(int32_t) ((sng->stereo >> 1) & 1);
+  int32_t l2 = -(int32_t) ((sng->stereo >> 6) & 1), r2 = -(int32_t) ((sng->stereo >> 2) & 1);
+  int32_t l3 = -(int32_t) ((sng->stereo >> 7) & 1), r3 = -(int32_t) ((sng->stereo >> 3) & 1);
+
+  uint32_t n, steps;
+
+  for (n = 0; n < frames; n++)
+  {
+    steps = 1;
+    if (quality)
+    {
+      /* Simple rate converter */
+      steps = 0;
+      while (realstep > sngtime)
+      {
+        sngtime += sngstep;
+        steps++;
+      }
+      sngtime -= realstep;
+    }
+
+    while (steps--)
+    {
+      uint32_t incr;
+
+      base_count += base_incr;
+      incr = base_count >> GETA_BITS;
+      base_count &= (1 << GETA_BITS) - 1;
+
+      /* Noise */
+      noise_count += incr;
+      if (noise_count & 0x100)
+      {
+        if (noise_mode) /* White */
+          noise_seed = (noise_seed >> 1) | (parity (noise_seed & 0x0009) << 15);
+        else            /* Periodic */
+          noise_seed = (noise_seed >> 1) | ((noise_seed & 1) << 15);
+        noise_count -= noise_period;
+      }
+      out3 = (out3 + (noise_seed & 1 ? noise_amp : 0)) >> 1;
+
+      /* Tone */
+      count0 += incr;
+      if (count0 & 0x400)
+      {
+        if (freq0 > 1)
+        {
+          edge0 = !edge0;
+          count0 -= freq0;
+        }
+        else
+          edge0 = 1;
+      }
+      count1 += incr;
+      if (count1 & 0x400)
+      {
+        if (freq1 > 1)
+        {
+          edge1 = !edge1;
+          count1 -= freq1;
+        }
+        else
+          edge1 = 1;
+      }
+      count2 += incr;
+      if (count2 & 0x400)
+      {
+        if (freq2 > 1)
+        {
+          edge2 = !edge2;
+          count2 -= freq2;
+        }
+        else
+          edge2 = 1;
+      }
+      out0 = (out0 + (edge0 ? amp0 : 0)) >> 1;
+      out1 = (out1 + (edge1 ? amp1 : 0)) >> 1;
+      out2 = (out2 + (edge2 ? amp2 : 0)) >> 1;
+    }
+
+    out[0] = (out0 & l0) + (out1 & l1) + (out2 & l2) + (out3 & l3);
+    out[1] = (out0 & r0) + (out1 & r1) + (out2 & r2) + (out3 & r3);
+    out += 2;
+  }
+
+  sng->base_count = base_count;
+  sng->sngtime = sngtime;
+  sng->count[0] = count0; sng->count[1] = count1; sng->count[2] = count2;
+  sng->edge[0] = edge0; sng->edge[1] = edge1; sng->edge[2] = edge2;
+  sng->noise_seed = noise_seed;
+  sng->noise_count = noise_count;
+  sng->ch_out[0] = out0; sng->ch_out[1] = out1; sng->ch_out[2] = out2; sng->ch_out[3] = out3;
+}
+
 void
 SNG_writeGGIO(SNG *sng, uint32_t val)
 {
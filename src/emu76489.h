@@ -51,6 +51,7 @@ uint8_t SNG_readIO(SNG *SNG) ;
 int16_t SNG_calc(SNG *) ;
 void SNG_setVolumeMode(SNG *SNG, int type) ;
 void SNG_calc_stereo(SNG *, int32_t out[2]) ;
+void SNG_calc_block(SNG *, int32_t *out, uint32_t frames) ;
 void SNG_writeGGIO(SNG *SNG, uint32_t val) ;
 
 #ifdef __cplusplus
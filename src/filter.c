@@ -0,0 +1,169 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "renuke.h"
+#include "renuke_internal.h"
+
+/* Console output filters: first and second order sections from the bilinear transform, run in transposed
+   direct form II over blocks of RN_FILTER_BLOCK samples. Each block is converted from the buffer's format
+   once, goes through the sections one after the other, each a tight loop per channel, and is converted
+   back, so the filter costs one pass over the buffer whatever the format. */
+
+#define RN_PI 3.14159265358979323846
+#define RN_FILTER_STAGES 3
+#define RN_FILTER_BLOCK 256
+
+enum
+{
+    RN_SECTION_NONE,
+    RN_SECTION_HIGHPASS1,
+    RN_SECTION_LOWPASS1,
+    RN_SECTION_LOWPASS2 /* Butterworth */
+};
+
+/* Corner frequencies of the audio path after the chip, approximations of measured consoles. The high-pass
+   is the output coupling capacitor. */
+static const struct
+{
+    uint8_t type;
+    double frequency;
+} models[][RN_FILTER_STAGES] =
+{
+    { { RN_SECTION_HIGHPASS1, 5.0 }, { RN_SECTION_LOWPASS1, 3390.0 }, { RN_SECTION_NONE, 0.0 } },  /* RN_MODEL_MD1 */
+    { { RN_SECTION_HIGHPASS1, 5.0 }, { RN_SECTION_LOWPASS2, 15000.0 }, { RN_SECTION_NONE, 0.0 } }, /* RN_MODEL_MD2 */
+    { { RN_SECTION_HIGHPASS1, 5.0 }, { RN_SECTION_LOWPASS1, 22000.0 }, { RN_SECTION_NONE, 0.0 } }, /* RN_MODEL_TERADRIVE */
+};
+
+typedef struct
+{
+    double b0, b1, b2, a1, a2;
+    double z[2][2]; /* Per channel */
+} RN_FilterSection;
+
+struct RN_OutputFilter
+{
+    uint32_t count;
+    RN_FilterSection sections[RN_FILTER_STAGES];
+};
+
+RN_OutputFilter *RN_OutputFilterCreate(RN_ConsoleModel model, double sample_rate)
+{
+    RN_OutputFilter *filter;
+
+    if(!(sample_rate > 0.0) || (uint32_t)model > RN_MODEL_TERADRIVE) return NULL;
+
+    filter = calloc(1, sizeof(RN_OutputFilter));
+    if(filter == NULL) return NULL;
+
+    for(uint32_t i = 0; i < RN_FILTER_STAGES; i++)
+    {
+        RN_FilterSection *section = &filter->sections[filter->count];
+        double k = tan(RN_PI * models[model][i].frequency / sample_rate);
+        double norm;
+
+        /* Corners at or near the Nyquist frequency have nothing left to filter */
+        if(models[model][i].type == RN_SECTION_NONE || models[model][i].frequency >= sample_rate * 0.45) continue;
+
+        switch(models[model][i].type)
+        {
+            case RN_SECTION_HIGHPASS1:
+                section->b0 = 1.0 / (1.0 + k);
+                section->b1 = -section->b0;
+                section->a1 = (k - 1.0) / (1.0 + k);
+                break;
+            case RN_SECTION_LOWPASS1:
+                section->b0 = k / (1.0 + k);
+                section->b1 = section->b0;
+                section->a1 = (k - 1.0) / (1.0 + k);
+                break;
+            default:
+                norm = 1.0 / (1.0 + k * sqrt(2.0) + k * k);
+                section->b0 = k * k * norm;
+                section->b1 = 2.0 * section->b0;
+                section->b2 = section->b0;
+                section->a1 = 2.0 * (k * k - 1.0) * norm;
+                section->a2 = (1.0 - k * sqrt(2.0) + k * k) * norm;
+                break;
+        }
+
+        filter->count++;
+    }
+
+    return filter;
+}
+
+void RN_OutputFilterDestroy(RN_OutputFilter *filter)
+{
+    free(filter);
+}
+
+void RN_OutputFilterReset(RN_OutputFilter *filter)
+{
+    for(uint32_t i = 0; i < filter->count; i++) memset(filter->sections[i].z, 0, sizeof(filter->sections[i].z));
+}
+
+static void RN_FilterSectionRun(RN_FilterSection *section, double *samples, uint32_t count, uint32_t channel)
+{
+    double b0 = section->b0, b1 = section->b1, b2 = section->b2, a1 = section->a1, a2 = section->a2;
+    double z0 = section->z[channel][0], z1 = section->z[channel][1];
+
+    for(uint32_t i = 0; i < count; i++)
+    {
+        double in = samples[i];
+        double out = b0 * in + z0;
+
+        z0 = b1 * in - a1 * out + z1;
+        z1 = b2 * in - a2 * out;
+        samples[i] = out;
+    }
+
+    section->z[channel][0] = z0;
+    section->z[channel][1] = z1;
+}
+
+/* Moves count samples of one channel between a buffer and a block, stride 1 for planar and 2 interleaved */
+#define RN_FILTER_LOAD(type) \
+    for(i = 0; i < count; i++) block[i] = (double)((const type *)source)[i * stride]
+
+#define RN_FILTER_STORE(type, convert) \
+    for(i = 0; i < count; i++) ((type *)source)[i * stride] = convert(block[i])
+
+#define RN_FILTER_TO_S16(x) (int16_t)lrint((x) < -32768.0 ? -32768.0 : (x) > 32767.0 ? 32767.0 : (x))
+#define RN_FILTER_TO_S32(x) (int32_t)lrint((x) < -2147483648.0 ? -2147483648.0 : (x) > 2147483647.0 ? 2147483647.0 : (x))
+#define RN_FILTER_TO_F32(x) (float)(x)
+
+void RN_OutputFilterProcess(RN_OutputFilter *filter, RN_SampleFormat format, void *buffer, void *right, uint32_t sample_count)
+{
+    RN_SampleFormat type = (RN_SampleFormat)(format & ~RN_FORMAT_PLANAR);
+    int planar = (format & RN_FORMAT_PLANAR) != 0;
+    size_t size = type == RN_FORMAT_S16 ? sizeof(int16_t) : sizeof(float);
+    uint32_t stride = planar ? 1 : 2;
+    double block[RN_FILTER_BLOCK];
+
+    for(uint32_t offset = 0; offset < sample_count; offset += RN_FILTER_BLOCK)
+    {
+        uint32_t count = sample_count - offset < RN_FILTER_BLOCK ? sample_count - offset : RN_FILTER_BLOCK;
+
+        for(uint32_t channel = 0; channel < 2; channel++)
+        {
+            uint8_t *source = planar ? (uint8_t *)(channel ? right : buffer) + offset * size : (uint8_t *)buffer + (offset * 2 + channel) * size;
+            uint32_t i;
+
+            switch(type)
+            {
+                case RN_FORMAT_S32: RN_FILTER_LOAD(int32_t); break;
+                case RN_FORMAT_F32: RN_FILTER_LOAD(float); break;
+                default: RN_FILTER_LOAD(int16_t); break;
+            }
+
+            for(uint32_t s = 0; s < filter->count; s++) RN_FilterSectionRun(&filter->sections[s], block, count, channel);
+
+            switch(type)
+            {
+                case RN_FORMAT_S32: RN_FILTER_STORE(int32_t, RN_FILTER_TO_S32); break;
+                case RN_FORMAT_F32: RN_FILTER_STORE(float, RN_FILTER_TO_F32); break;
+                default: RN_FILTER_STORE(int16_t, RN_FILTER_TO_S16); break;
+            }
+        }
+    }
+}
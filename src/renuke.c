@@ -1,179 +1,53 @@
+#if defined(RN_PROFILING) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 199309L /* clock_gettime */
+#endif
+
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include "renuke.h"
+#include "renuke_internal.h"
+
+/* renuke_isa.c builds this file again per ISA level with RN_ISA set, keeping only the clock paths and
+   their RN_Kernels table under its own name */
+#ifndef RN_KERNELS
+#define RN_KERNELS RN_kernels_baseline
+#define RN_KERNELS_NAME "baseline"
+#endif
 
 #define SIGN_EXTEND(bit_index, value) (((value) & ((1u << (bit_index)) - 1u)) - ((value) & (1u << (bit_index))))
 #define CLAMP(x, low, high) (((x) < (low)) ? (low) : (((x) > (high)) ? (high) : (x)))
-#define RN_GAIN 32
 
-typedef struct
+#ifdef RN_PROFILING
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline uint64_t RN_ProfileTicks(void)
 {
-    uint16_t port;
-    uint8_t data;
-} ScheduledWrite;
-
-/* Full structure definition - now private to implementation */
-struct RN_Chip
+    return __rdtsc();
+}
+#elif defined(_MSC_VER)
+#include <intrin.h>
+static inline uint64_t RN_ProfileTicks(void)
 {
-    uint32_t cycles;
-    uint32_t channel;
-    int16_t mol, mor;
-    /* IO */
-    uint16_t write_data;
-    uint8_t write_a;
-    uint8_t write_d;
-    uint8_t write_a_en;
-    uint8_t write_d_en;
-    uint8_t write_busy;
-    uint8_t write_busy_cnt;
-    uint8_t write_fm_address;
-    uint8_t write_fm_data;
-    uint16_t write_fm_mode_a;
-    uint16_t address;
-    uint8_t data;
-    uint8_t pin_test_in;
-    uint8_t pin_irq;
-    uint8_t busy;
-    /* LFO */
-    uint8_t lfo_en;
-    uint8_t lfo_freq;
-    uint8_t lfo_pm;
-    uint8_t lfo_am;
-    uint8_t lfo_cnt;
-    uint8_t lfo_inc;
-    uint8_t lfo_quotient;
-    /* Phase generator */
-    uint16_t pg_fnum;
-    uint8_t pg_block;
-    uint8_t pg_kcode;
-    uint32_t pg_inc[24];
-    uint32_t pg_phase[24];
-    uint8_t pg_reset[24];
-    uint32_t pg_read;
-    /* Envelope generator */
-    uint8_t eg_cycle;
-    uint8_t eg_cycle_stop;
-    uint8_t eg_shift;
-    uint8_t eg_shift_lock;
-    uint8_t eg_timer_low_lock;
-    uint16_t eg_timer;
-    uint8_t eg_timer_inc;
-    uint16_t eg_quotient;
-    uint8_t eg_custom_timer;
-    uint8_t eg_rate;
-    uint8_t eg_ksv;
-    uint8_t eg_inc;
-    uint8_t eg_ratemax;
-    uint8_t eg_sl[2];
-    uint8_t eg_lfo_am;
-    uint8_t eg_tl[2];
-    uint8_t eg_state[24];
-    uint16_t eg_level[24];
-    uint16_t eg_out[24];
-    uint8_t eg_kon[24];
-    uint8_t eg_kon_csm[24];
-    uint8_t eg_kon_latch[24];
-    uint8_t eg_csm_mode[24];
-    uint8_t eg_ssg_enable[24];
-    uint8_t eg_ssg_pgrst_latch[24];
-    uint8_t eg_ssg_repeat_latch[24];
-    uint8_t eg_ssg_hold_up_latch[24];
-    uint8_t eg_ssg_dir[24];
-    uint8_t eg_ssg_inv[24];
-    uint32_t eg_read[2];
-    uint8_t eg_read_inc;
-    /* FM */
-    int16_t fm_op1[6][2];
-    int16_t fm_op2[6];
-    int16_t fm_out[24];
-    uint16_t fm_mod[24];
-    /* Channel */
-    int16_t ch_acc[6];
-    int16_t ch_out[6];
-    int16_t ch_lock;
-    uint8_t ch_lock_l;
-    uint8_t ch_lock_r;
-    int16_t ch_read;
-    /* Timer */
-    uint16_t timer_a_cnt;
-    uint16_t timer_a_reg;
-    uint8_t timer_a_load_lock;
-    uint8_t timer_a_load;
-    uint8_t timer_a_enable;
-    uint8_t timer_a_reset;
-    uint8_t timer_a_load_latch;
-    uint8_t timer_a_overflow_flag;
-    uint8_t timer_a_overflow;
-
-    uint16_t timer_b_cnt;
-    uint8_t timer_b_subcnt;
-    uint16_t timer_b_reg;
-    uint8_t timer_b_load_lock;
-    uint8_t timer_b_load;
-    uint8_t timer_b_enable;
-    uint8_t timer_b_reset;
-    uint8_t timer_b_load_latch;
-    uint8_t timer_b_overflow_flag;
-    uint8_t timer_b_overflow;
-
-    /* Register set */
-    uint8_t mode_test_21[8];
-    uint8_t mode_test_2c[8];
-    uint8_t mode_ch3;
-    uint8_t mode_kon_channel;
-    uint8_t mode_kon_operator[4];
-    uint8_t mode_kon[24];
-    uint8_t mode_csm;
-    uint8_t mode_kon_csm;
-    uint8_t dacen;
-    int16_t dacdata;
-
-    uint8_t ks[24];
-    uint8_t ar[24];
-    uint8_t sr[24];
-    uint8_t dt[24];
-    uint8_t multi[24];
-    uint8_t sl[24];
-    uint8_t rr[24];
-    uint8_t dr[24];
-    uint8_t am[24];
-    uint8_t tl[24];
-    uint8_t ssg_eg[24];
-
-    uint16_t fnum[6];
-    uint8_t block[6];
-    uint8_t kcode[6];
-    uint16_t fnum_3ch[6];
-    uint8_t block_3ch[6];
-    uint8_t kcode_3ch[6];
-    uint8_t reg_a4;
-    uint8_t reg_ac;
-    uint8_t connect[6];
-    uint8_t fb[6];
-    uint8_t pan_l[6], pan_r[6];
-    uint8_t ams[6];
-    uint8_t pms[6];
-    uint8_t status;
-    uint32_t status_time;
-
-    /* Chip configuration */
-    RN_ChipType chip_type;
-    
-    /* Buffered output samples */
-    int32_t current_sample[2];
-    int16_t *sample_queue;
-    uint32_t sample_enqueue_position;
-    uint32_t sample_dequeue_position;
-
-    // Write scheduling
-    int next_write_clocks;
-    int next_note_clocks;
-    ScheduledWrite* write_queue;
-    uint32_t write_enqueue_position;
-    uint32_t write_dequeue_position;
-};
+    return __rdtsc();
+}
+#else
+#include <time.h>
+static inline uint64_t RN_ProfileTicks(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+#endif
+/* Lap timing: every RN_PROFILE_LAP charges the time since the previous lap to a stage */
+#define RN_PROFILE_START() uint64_t profile_lap = RN_ProfileTicks()
+#define RN_PROFILE_LAP(chip, stage) do { uint64_t profile_now = RN_ProfileTicks(); (chip)->profile.ticks[stage] += profile_now - profile_lap; profile_lap = profile_now; } while (0)
+#else
+#define RN_PROFILE_START() do { } while (0)
+#define RN_PROFILE_LAP(chip, stage) do { } while (0)
+#endif
 
 enum
 {
@@ -368,11 +242,167 @@ static void RN_DoIO(RN_Chip *chip)
     chip->write_busy_cnt &= 0x1f;
 }
 
-static void RN_DoRegWrite(RN_Chip *chip)
+/* Register decoding, shared by the pipelined write path and the per-sample engine */
+static void RN_WriteSlotRegister(RN_Chip *chip, uint32_t slot, uint32_t address, uint8_t data)
+{
+    switch (address)
+    {
+    case 0x30: /* DT, MULTI */
+        chip->multi[slot] = data & 0x0f;
+        if (!chip->multi[slot])
+        {
+            chip->multi[slot] = 1;
+        }
+        else
+        {
+            chip->multi[slot] <<= 1;
+        }
+        chip->dt[slot] = (data >> 4) & 0x07;
+        break;
+    case 0x40: /* TL */
+        chip->tl[slot] = data & 0x7f;
+        break;
+    case 0x50: /* KS, AR */
+        chip->ar[slot] = data & 0x1f;
+        chip->ks[slot] = (data >> 6) & 0x03;
+        break;
+    case 0x60: /* AM, DR */
+        chip->dr[slot] = data & 0x1f;
+        RN_SET_FLAG(chip->am, slot, (data >> 7) & 0x01);
+        break;
+    case 0x70: /* SR */
+        chip->sr[slot] = data & 0x1f;
+        break;
+    case 0x80: /* SL, RR */
+        chip->rr[slot] = data & 0x0f;
+        chip->sl[slot] = (data >> 4) & 0x0f;
+        chip->sl[slot] |= (chip->sl[slot] + 1) & 0x10;
+        break;
+    case 0x90: /* SSG-EG */
+        chip->ssg_eg[slot] = data & 0x0f;
+        break;
+    default:
+        break;
+    }
+}
+
+static void RN_WriteChannelRegister(RN_Chip *chip, uint32_t channel, uint32_t address, uint8_t data)
+{
+    switch (address)
+    {
+    case 0xa0:
+        chip->fnum[channel] = (data & 0xff) | ((chip->reg_a4 & 0x07) << 8);
+        chip->block[channel] = (chip->reg_a4 >> 3) & 0x07;
+        chip->kcode[channel] = (chip->block[channel] << 2) | fn_note[chip->fnum[channel] >> 7];
+        break;
+    case 0xa4:
+        chip->reg_a4 = data & 0xff;
+        break;
+    case 0xa8:
+        chip->fnum_3ch[channel] = (data & 0xff) | ((chip->reg_ac & 0x07) << 8);
+        chip->block_3ch[channel] = (chip->reg_ac >> 3) & 0x07;
+        chip->kcode_3ch[channel] = (chip->block_3ch[channel] << 2) | fn_note[chip->fnum_3ch[channel] >> 7];
+        break;
+    case 0xac:
+        chip->reg_ac = data & 0xff;
+        break;
+    case 0xb0:
+        chip->connect[channel] = data & 0x07;
+        chip->fb[channel] = (data >> 3) & 0x07;
+        break;
+    case 0xb4:
+        chip->pms[channel] = data & 0x07;
+        chip->ams[channel] = (data >> 4) & 0x03;
+        chip->pan_l[channel] = (data >> 7) & 0x01;
+        chip->pan_r[channel] = (data >> 6) & 0x01;
+        break;
+    default:
+        break;
+    }
+}
+
+static void RN_WriteModeRegister(RN_Chip *chip, uint32_t address, uint8_t data)
 {
     uint32_t i;
+    switch (address)
+    {
+    case 0x21: /* LSI test 1 */
+        for (i = 0; i < 8; i++)
+        {
+            RN_SET_FLAG(chip->mode_test_21, i, (data >> i) & 0x01);
+        }
+        break;
+    case 0x22: /* LFO control */
+        if ((data >> 3) & 0x01)
+        {
+            chip->lfo_en = 0x7f;
+        }
+        else
+        {
+            chip->lfo_en = 0;
+        }
+        chip->lfo_freq = data & 0x07;
+        break;
+    case 0x24: /* Timer A */
+        chip->timer_a_reg &= 0x03;
+        chip->timer_a_reg |= (data & 0xff) << 2;
+        break;
+    case 0x25:
+        chip->timer_a_reg &= 0x3fc;
+        chip->timer_a_reg |= data & 0x03;
+        break;
+    case 0x26: /* Timer B */
+        chip->timer_b_reg = data & 0xff;
+        break;
+    case 0x27: /* CSM, Timer control */
+        chip->mode_ch3 = (data & 0xc0) >> 6;
+        chip->mode_csm = chip->mode_ch3 == 2;
+        chip->timer_a_load = data & 0x01;
+        chip->timer_a_enable = (data >> 2) & 0x01;
+        chip->timer_a_reset = (data >> 4) & 0x01;
+        chip->timer_b_load = (data >> 1) & 0x01;
+        chip->timer_b_enable = (data >> 3) & 0x01;
+        chip->timer_b_reset = (data >> 5) & 0x01;
+        break;
+    case 0x28: /* Key on/off */
+        for (i = 0; i < 4; i++)
+        {
+            chip->mode_kon_operator[i] = (data >> (4 + i)) & 0x01;
+        }
+        if ((data & 0x03) == 0x03)
+        {
+            /* Invalid address */
+            chip->mode_kon_channel = 0xff;
+        }
+        else
+        {
+            chip->mode_kon_channel = (data & 0x03) + ((data >> 2) & 1) * 3;
+        }
+        break;
+    case 0x2a: /* DAC data */
+        chip->dacdata &= 0x01;
+        chip->dacdata |= (data ^ 0x80) << 1;
+        break;
+    case 0x2b: /* DAC enable */
+        chip->dacen = data >> 7;
+        break;
+    case 0x2c: /* LSI test 2 */
+        for (i = 0; i < 8; i++)
+        {
+            RN_SET_FLAG(chip->mode_test_2c, i, (data >> i) & 0x01);
+        }
+        chip->dacdata &= 0x1fe;
+        chip->dacdata |= RN_FLAG(chip->mode_test_2c, 3);
+        chip->eg_custom_timer = !RN_FLAG(chip->mode_test_2c, 7) && RN_FLAG(chip->mode_test_2c, 6);
+        break;
+    default:
+        break;
+    }
+}
+
+static void RN_DoRegWrite(RN_Chip *chip)
+{
     uint32_t slot = chip->cycles % 12;
-    uint32_t address;
     uint32_t channel = chip->channel;
     /* Update registers */
     if (chip->write_fm_data)
@@ -385,83 +415,13 @@ static void RN_DoRegWrite(RN_Chip *chip)
                 /* OP2, OP4 */
                 slot += 12;
             }
-            address = chip->address & 0xf0;
-            switch (address)
-            {
-            case 0x30: /* DT, MULTI */
-                chip->multi[slot] = chip->data & 0x0f;
-                if (!chip->multi[slot])
-                {
-                    chip->multi[slot] = 1;
-                }
-                else
-                {
-                    chip->multi[slot] <<= 1;
-                }
-                chip->dt[slot] = (chip->data >> 4) & 0x07;
-                break;
-            case 0x40: /* TL */
-                chip->tl[slot] = chip->data & 0x7f;
-                break;
-            case 0x50: /* KS, AR */
-                chip->ar[slot] = chip->data & 0x1f;
-                chip->ks[slot] = (chip->data >> 6) & 0x03;
-                break;
-            case 0x60: /* AM, DR */
-                chip->dr[slot] = chip->data & 0x1f;
-                chip->am[slot] = (chip->data >> 7) & 0x01;
-                break;
-            case 0x70: /* SR */
-                chip->sr[slot] = chip->data & 0x1f;
-                break;
-            case 0x80: /* SL, RR */
-                chip->rr[slot] = chip->data & 0x0f;
-                chip->sl[slot] = (chip->data >> 4) & 0x0f;
-                chip->sl[slot] |= (chip->sl[slot] + 1) & 0x10;
-                break;
-            case 0x90: /* SSG-EG */
-                chip->ssg_eg[slot] = chip->data & 0x0f;
-                break;
-            default:
-                break;
-            }
+            RN_WriteSlotRegister(chip, slot, chip->address & 0xf0, chip->data);
         }
 
         /* Channel */
         if (ch_offset[channel] == (chip->address & 0x103))
         {
-            address = chip->address & 0xfc;
-            switch (address)
-            {
-            case 0xa0:
-                chip->fnum[channel] = (chip->data & 0xff) | ((chip->reg_a4 & 0x07) << 8);
-                chip->block[channel] = (chip->reg_a4 >> 3) & 0x07;
-                chip->kcode[channel] = (chip->block[channel] << 2) | fn_note[chip->fnum[channel] >> 7];
-                break;
-            case 0xa4:
-                chip->reg_a4 = chip->data & 0xff;
-                break;
-            case 0xa8:
-                chip->fnum_3ch[channel] = (chip->data & 0xff) | ((chip->reg_ac & 0x07) << 8);
-                chip->block_3ch[channel] = (chip->reg_ac >> 3) & 0x07;
-                chip->kcode_3ch[channel] = (chip->block_3ch[channel] << 2) | fn_note[chip->fnum_3ch[channel] >> 7];
-                break;
-            case 0xac:
-                chip->reg_ac = chip->data & 0xff;
-                break;
-            case 0xb0:
-                chip->connect[channel] = chip->data & 0x07;
-                chip->fb[channel] = (chip->data >> 3) & 0x07;
-                break;
-            case 0xb4:
-                chip->pms[channel] = chip->data & 0x07;
-                chip->ams[channel] = (chip->data >> 4) & 0x03;
-                chip->pan_l[channel] = (chip->data >> 7) & 0x01;
-                chip->pan_r[channel] = (chip->data >> 6) & 0x01;
-                break;
-            default:
-                break;
-            }
+            RN_WriteChannelRegister(chip, channel, chip->address & 0xfc, chip->data);
         }
     }
 
@@ -498,80 +458,7 @@ static void RN_DoRegWrite(RN_Chip *chip)
         /* Data */
         if (chip->write_d_en && (chip->write_data & 0x100) == 0)
         {
-            switch (chip->write_fm_mode_a)
-            {
-            case 0x21: /* LSI test 1 */
-                for (i = 0; i < 8; i++)
-                {
-                    chip->mode_test_21[i] = (chip->write_data >> i) & 0x01;
-                }
-                break;
-            case 0x22: /* LFO control */
-                if ((chip->write_data >> 3) & 0x01)
-                {
-                    chip->lfo_en = 0x7f;
-                }
-                else
-                {
-                    chip->lfo_en = 0;
-                }
-                chip->lfo_freq = chip->write_data & 0x07;
-                break;
-            case 0x24: /* Timer A */
-                chip->timer_a_reg &= 0x03;
-                chip->timer_a_reg |= (chip->write_data & 0xff) << 2;
-                break;
-            case 0x25:
-                chip->timer_a_reg &= 0x3fc;
-                chip->timer_a_reg |= chip->write_data & 0x03;
-                break;
-            case 0x26: /* Timer B */
-                chip->timer_b_reg = chip->write_data & 0xff;
-                break;
-            case 0x27: /* CSM, Timer control */
-                chip->mode_ch3 = (chip->write_data & 0xc0) >> 6;
-                chip->mode_csm = chip->mode_ch3 == 2;
-                chip->timer_a_load = chip->write_data & 0x01;
-                chip->timer_a_enable = (chip->write_data >> 2) & 0x01;
-                chip->timer_a_reset = (chip->write_data >> 4) & 0x01;
-                chip->timer_b_load = (chip->write_data >> 1) & 0x01;
-                chip->timer_b_enable = (chip->write_data >> 3) & 0x01;
-                chip->timer_b_reset = (chip->write_data >> 5) & 0x01;
-                break;
-            case 0x28: /* Key on/off */
-                for (i = 0; i < 4; i++)
-                {
-                    chip->mode_kon_operator[i] = (chip->write_data >> (4 + i)) & 0x01;
-                }
-                if ((chip->write_data & 0x03) == 0x03)
-                {
-                    /* Invalid address */
-                    chip->mode_kon_channel = 0xff;
-                }
-                else
-                {
-                    chip->mode_kon_channel = (chip->write_data & 0x03) + ((chip->write_data >> 2) & 1) * 3;
-                }
-                break;
-            case 0x2a: /* DAC data */
-                chip->dacdata &= 0x01;
-                chip->dacdata |= (chip->write_data ^ 0x80) << 1;
-                break;
-            case 0x2b: /* DAC enable */
-                chip->dacen = chip->write_data >> 7;
-                break;
-            case 0x2c: /* LSI test 2 */
-                for (i = 0; i < 8; i++)
-                {
-                    chip->mode_test_2c[i] = (chip->write_data >> i) & 0x01;
-                }
-                chip->dacdata &= 0x1fe;
-                chip->dacdata |= chip->mode_test_2c[3];
-                chip->eg_custom_timer = !chip->mode_test_2c[7] && chip->mode_test_2c[6];
-                break;
-            default:
-                break;
-            }
+            RN_WriteModeRegister(chip, chip->write_fm_mode_a, chip->write_data & 0xff);
         }
 
         /* Address */
@@ -587,23 +474,16 @@ static void RN_DoRegWrite(RN_Chip *chip)
     }
 }
 
-static void RN_PhaseCalcIncrement(RN_Chip *chip)
+static uint32_t RN_PhaseIncrement(uint32_t fnum, uint8_t block, uint8_t kcode, uint8_t lfo, uint8_t pms, uint8_t dt, uint8_t multi)
 {
-    uint32_t chan = chip->channel;
-    uint32_t slot = chip->cycles;
-    uint32_t fnum = chip->pg_fnum;
     uint32_t fnum_h = fnum >> 4;
     uint32_t fm;
     uint32_t basefreq;
-    uint8_t lfo = chip->lfo_pm;
     uint8_t lfo_l = lfo & 0x0f;
-    uint8_t pms = chip->pms[chan];
-    uint8_t dt = chip->dt[slot];
     uint8_t dt_l = dt & 0x03;
     uint8_t detune = 0;
-    uint8_t block, note;
+    uint8_t note;
     uint8_t sum, sum_h, sum_l;
-    uint8_t kcode = chip->pg_kcode;
 
     fnum <<= 1;
     /* Apply LFO */
@@ -627,7 +507,7 @@ static void RN_PhaseCalcIncrement(RN_Chip *chip)
     }
     fnum &= 0xfff;
 
-    basefreq = (fnum << chip->pg_block) >> 2;
+    basefreq = (fnum << block) >> 2;
 
     /* Apply detune */
     if (dt_l)
@@ -652,8 +532,14 @@ static void RN_PhaseCalcIncrement(RN_Chip *chip)
         basefreq += detune;
     }
     basefreq &= 0x1ffff;
-    chip->pg_inc[slot] = (basefreq * chip->multi[slot]) >> 1;
-    chip->pg_inc[slot] &= 0xfffff;
+    return ((basefreq * multi) >> 1) & 0xfffff;
+}
+
+static void RN_PhaseCalcIncrement(RN_Chip *chip)
+{
+    uint32_t slot = chip->cycles;
+    chip->pg_inc[slot] = RN_PhaseIncrement(chip->pg_fnum, chip->pg_block, chip->pg_kcode, chip->lfo_pm,
+        chip->pms[chip->channel], chip->dt[slot], chip->multi[slot]);
 }
 
 static void RN_PhaseGenerate(RN_Chip *chip)
@@ -661,13 +547,13 @@ static void RN_PhaseGenerate(RN_Chip *chip)
     uint32_t slot;
     /* Mask increment */
     slot = (chip->cycles + 20) % 24;
-    if (chip->pg_reset[slot])
+    if (RN_FLAG(chip->pg_reset, slot))
     {
         chip->pg_inc[slot] = 0;
     }
     /* Phase step */
     slot = (chip->cycles + 19) % 24;
-    if (chip->pg_reset[slot] || chip->mode_test_21[3])
+    if (RN_FLAG(chip->pg_reset, slot) || RN_FLAG(chip->mode_test_21, 3))
     {
         chip->pg_phase[slot] = 0;
     }
@@ -679,23 +565,23 @@ static void RN_EnvelopeSSGEG(RN_Chip *chip)
 {
     uint32_t slot = chip->cycles;
     uint8_t direction = 0;
-    chip->eg_ssg_pgrst_latch[slot] = 0;
-    chip->eg_ssg_repeat_latch[slot] = 0;
-    chip->eg_ssg_hold_up_latch[slot] = 0;
+    RN_SET_FLAG(chip->eg_ssg_pgrst_latch, slot, 0);
+    RN_SET_FLAG(chip->eg_ssg_repeat_latch, slot, 0);
+    RN_SET_FLAG(chip->eg_ssg_hold_up_latch, slot, 0);
     if (chip->ssg_eg[slot] & 0x08)
     {
-        direction = chip->eg_ssg_dir[slot];
+        direction = RN_FLAG(chip->eg_ssg_dir, slot);
         if (chip->eg_level[slot] & 0x200)
         {
             /* Reset */
             if ((chip->ssg_eg[slot] & 0x03) == 0x00)
             {
-                chip->eg_ssg_pgrst_latch[slot] = 1;
+                RN_SET_FLAG(chip->eg_ssg_pgrst_latch, slot, 1);
             }
             /* Repeat */
             if ((chip->ssg_eg[slot] & 0x01) == 0x00)
             {
-                chip->eg_ssg_repeat_latch[slot] = 1;
+                RN_SET_FLAG(chip->eg_ssg_repeat_latch, slot, 1);
             }
             /* Inverse */
             if ((chip->ssg_eg[slot] & 0x03) == 0x02)
@@ -708,23 +594,23 @@ static void RN_EnvelopeSSGEG(RN_Chip *chip)
             }
         }
         /* Hold up */
-        if (chip->eg_kon_latch[slot] && ((chip->ssg_eg[slot] & 0x07) == 0x05 || (chip->ssg_eg[slot] & 0x07) == 0x03))
+        if (RN_FLAG(chip->eg_kon_latch, slot) && ((chip->ssg_eg[slot] & 0x07) == 0x05 || (chip->ssg_eg[slot] & 0x07) == 0x03))
         {
-            chip->eg_ssg_hold_up_latch[slot] = 1;
+            RN_SET_FLAG(chip->eg_ssg_hold_up_latch, slot, 1);
         }
-        direction &= chip->eg_kon[slot];
+        direction &= RN_FLAG(chip->eg_kon, slot);
     }
-    chip->eg_ssg_dir[slot] = direction;
-    chip->eg_ssg_enable[slot] = (chip->ssg_eg[slot] >> 3) & 0x01;
-    chip->eg_ssg_inv[slot] = (chip->eg_ssg_dir[slot] ^ (((chip->ssg_eg[slot] >> 2) & 0x01) & ((chip->ssg_eg[slot] >> 3) & 0x01))) & chip->eg_kon[slot];
+    RN_SET_FLAG(chip->eg_ssg_dir, slot, direction);
+    RN_SET_FLAG(chip->eg_ssg_enable, slot, (chip->ssg_eg[slot] >> 3) & 0x01);
+    RN_SET_FLAG(chip->eg_ssg_inv, slot, (RN_FLAG(chip->eg_ssg_dir, slot) ^ (((chip->ssg_eg[slot] >> 2) & 0x01) & ((chip->ssg_eg[slot] >> 3) & 0x01))) & RN_FLAG(chip->eg_kon, slot));
 }
 
 static void RN_EnvelopeADSR(RN_Chip *chip)
 {
     uint32_t slot = (chip->cycles + 22) % 24;
 
-    uint8_t nkon = chip->eg_kon_latch[slot];
-    uint8_t okon = chip->eg_kon[slot];
+    uint8_t nkon = RN_FLAG(chip->eg_kon_latch, slot);
+    uint8_t okon = RN_FLAG(chip->eg_kon, slot);
     uint8_t kon_event;
     uint8_t koff_event;
     uint8_t eg_off;
@@ -737,15 +623,15 @@ static void RN_EnvelopeADSR(RN_Chip *chip)
     chip->eg_read_inc = chip->eg_inc > 0;
 
     /* Reset phase generator */
-    chip->pg_reset[slot] = (nkon && !okon) || chip->eg_ssg_pgrst_latch[slot];
+    RN_SET_FLAG(chip->pg_reset, slot, (nkon && !okon) || RN_FLAG(chip->eg_ssg_pgrst_latch, slot));
 
     /* KeyOn/Off */
-    kon_event = (nkon && !okon) || (okon && chip->eg_ssg_repeat_latch[slot]);
+    kon_event = (nkon && !okon) || (okon && RN_FLAG(chip->eg_ssg_repeat_latch, slot));
     koff_event = okon && !nkon;
 
     ssg_level = level = (int16_t)chip->eg_level[slot];
 
-    if (chip->eg_ssg_inv[slot])
+    if (RN_FLAG(chip->eg_ssg_inv, slot))
     {
         /* Inverse */
         ssg_level = 512 - level;
@@ -755,7 +641,7 @@ static void RN_EnvelopeADSR(RN_Chip *chip)
     {
         level = ssg_level;
     }
-    if (chip->eg_ssg_enable[slot])
+    if (RN_FLAG(chip->eg_ssg_enable, slot))
     {
         eg_off = level >> 9;
     }
@@ -799,7 +685,7 @@ static void RN_EnvelopeADSR(RN_Chip *chip)
             else if (!eg_off && chip->eg_inc)
             {
                 inc = 1 << (chip->eg_inc - 1);
-                if (chip->eg_ssg_enable[slot])
+                if (RN_FLAG(chip->eg_ssg_enable, slot))
                 {
                     inc <<= 2;
                 }
@@ -810,7 +696,7 @@ static void RN_EnvelopeADSR(RN_Chip *chip)
             if (!eg_off && chip->eg_inc)
             {
                 inc = 1 << (chip->eg_inc - 1);
-                if (chip->eg_ssg_enable[slot])
+                if (RN_FLAG(chip->eg_ssg_enable, slot))
                 {
                     inc <<= 2;
                 }
@@ -824,13 +710,13 @@ static void RN_EnvelopeADSR(RN_Chip *chip)
             nextstate = eg_num_release;
         }
     }
-    if (chip->eg_kon_csm[slot])
+    if (RN_FLAG(chip->eg_kon_csm, slot))
     {
         nextlevel |= chip->eg_tl[1] << 3;
     }
 
     /* Envelope off */
-    if (!kon_event && !chip->eg_ssg_hold_up_latch[slot] && chip->eg_state[slot] != eg_num_attack && eg_off)
+    if (!kon_event && !RN_FLAG(chip->eg_ssg_hold_up_latch, slot) && chip->eg_state[slot] != eg_num_attack && eg_off)
     {
         nextstate = eg_num_release;
         nextlevel = 0x3ff;
@@ -838,15 +724,48 @@ static void RN_EnvelopeADSR(RN_Chip *chip)
 
     nextlevel += inc;
 
-    chip->eg_kon[slot] = chip->eg_kon_latch[slot];
+    RN_SET_FLAG(chip->eg_kon, slot, RN_FLAG(chip->eg_kon_latch, slot));
     chip->eg_level[slot] = (uint16_t)nextlevel & 0x3ff;
     chip->eg_state[slot] = nextstate;
 }
 
+/* Envelope increment of a rate (0-63) on a step of the envelope timer */
+static uint8_t RN_EnvelopeIncrement(uint8_t rate, uint8_t shift_lock, uint8_t timer_low_lock)
+{
+    uint8_t sum = ((rate >> 2) + shift_lock) & 0x0f;
+    uint8_t inc = 0;
+
+    if (rate < 48)
+    {
+        switch (sum)
+        {
+        case 12:
+            inc = 1;
+            break;
+        case 13:
+            inc = (rate >> 1) & 0x01;
+            break;
+        case 14:
+            inc = rate & 0x01;
+            break;
+        default:
+            break;
+        }
+    }
+    else
+    {
+        inc = eg_stephi[rate & 0x03][timer_low_lock] + (rate >> 2) - 11;
+        if (inc > 4)
+        {
+            inc = 4;
+        }
+    }
+    return inc;
+}
+
 static void RN_EnvelopePrepare(RN_Chip *chip)
 {
     uint8_t rate;
-    uint8_t sum;
     uint8_t inc = 0;
     uint32_t slot = chip->cycles;
     uint8_t rate_sel;
@@ -859,41 +778,16 @@ static void RN_EnvelopePrepare(RN_Chip *chip)
         rate = 0x3f;
     }
 
-    sum = ((rate >> 2) + chip->eg_shift_lock) & 0x0f;
     if (chip->eg_rate != 0 && chip->eg_quotient == 2)
     {
-        if (rate < 48)
-        {
-            switch (sum)
-            {
-            case 12:
-                inc = 1;
-                break;
-            case 13:
-                inc = (rate >> 1) & 0x01;
-                break;
-            case 14:
-                inc = rate & 0x01;
-                break;
-            default:
-                break;
-            }
-        }
-        else
-        {
-            inc = eg_stephi[rate & 0x03][chip->eg_timer_low_lock] + (rate >> 2) - 11;
-            if (inc > 4)
-            {
-                inc = 4;
-            }
-        }
+        inc = RN_EnvelopeIncrement(rate, chip->eg_shift_lock, chip->eg_timer_low_lock);
     }
     chip->eg_inc = inc;
     chip->eg_ratemax = (rate >> 1) == 0x1f;
 
     /* Prepare rate & ksv */
     rate_sel = chip->eg_state[slot];
-    if ((chip->eg_kon[slot] && chip->eg_ssg_repeat_latch[slot]) || (!chip->eg_kon[slot] && chip->eg_kon_latch[slot]))
+    if ((RN_FLAG(chip->eg_kon, slot) && RN_FLAG(chip->eg_ssg_repeat_latch, slot)) || (!RN_FLAG(chip->eg_kon, slot) && RN_FLAG(chip->eg_kon_latch, slot)))
     {
         rate_sel = eg_num_attack;
     }
@@ -915,7 +809,7 @@ static void RN_EnvelopePrepare(RN_Chip *chip)
         break;
     }
     chip->eg_ksv = chip->pg_kcode >> (chip->ks[slot] ^ 0x03);
-    if (chip->am[slot])
+    if (RN_FLAG(chip->am, slot))
     {
         chip->eg_lfo_am = chip->lfo_am >> eg_am_shift[chip->ams[chip->channel]];
     }
@@ -937,12 +831,12 @@ static void RN_EnvelopeGenerate(RN_Chip *chip)
 
     level = chip->eg_level[slot];
 
-    if (chip->eg_ssg_inv[slot])
+    if (RN_FLAG(chip->eg_ssg_inv, slot))
     {
         /* Inverse */
         level = 512 - level;
     }
-    if (chip->mode_test_21[5])
+    if (RN_FLAG(chip->mode_test_21, 5))
     {
         level = 0;
     }
@@ -977,14 +871,11 @@ static void RN_UpdateLFO(RN_Chip *chip)
     chip->lfo_cnt &= chip->lfo_en;
 }
 
-static void RN_FMPrepare(RN_Chip *chip)
+/* Modulation input of operator op (slot / 6) of a channel, last is the output of the previous slot */
+static int16_t RN_FMModulation(const RN_Chip *chip, uint32_t op, uint32_t channel, int16_t last)
 {
-    uint32_t slot = (chip->cycles + 6) % 24;
-    uint32_t channel = chip->channel;
     int16_t mod, mod1, mod2;
-    uint32_t op = slot / 6;
     uint8_t connect = chip->connect[channel];
-    uint32_t prevslot = (chip->cycles + 18) % 24;
 
     /* Calculate modulation */
     mod1 = mod2 = 0;
@@ -1003,11 +894,11 @@ static void RN_FMPrepare(RN_Chip *chip)
     }
     if (fm_algorithm[op][3][connect])
     {
-        mod2 |= chip->fm_out[prevslot];
+        mod2 |= last;
     }
     if (fm_algorithm[op][4][connect])
     {
-        mod1 |= chip->fm_out[prevslot];
+        mod1 |= last;
     }
     mod = mod1 + mod2;
     if (op == 0)
@@ -1023,7 +914,16 @@ static void RN_FMPrepare(RN_Chip *chip)
     {
         mod >>= 1;
     }
-    chip->fm_mod[slot] = mod;
+    return mod;
+}
+
+static void RN_FMPrepare(RN_Chip *chip)
+{
+    uint32_t slot = (chip->cycles + 6) % 24;
+    uint32_t channel = chip->channel;
+    uint32_t prevslot = (chip->cycles + 18) % 24;
+
+    chip->fm_mod[slot] = RN_FMModulation(chip, slot / 6, channel, chip->fm_out[prevslot]);
 
     slot = (chip->cycles + 18) % 24;
     /* OP1 */
@@ -1044,7 +944,7 @@ static void RN_ChGenerate(RN_Chip *chip)
     uint32_t slot = (chip->cycles + 18) % 24;
     uint32_t channel = chip->channel;
     uint32_t op = slot / 6;
-    uint32_t test_dac = chip->mode_test_2c[5];
+    uint32_t test_dac = RN_FLAG(chip->mode_test_2c, 5);
     int16_t acc = chip->ch_acc[channel];
     int16_t add = test_dac;
     int16_t sum = 0;
@@ -1079,7 +979,7 @@ static void RN_ChOutput(RN_Chip *chip)
     uint32_t cycles = chip->cycles;
     uint32_t slot = chip->cycles;
     uint32_t channel = chip->channel;
-    uint32_t test_dac = chip->mode_test_2c[5];
+    uint32_t test_dac = RN_FLAG(chip->mode_test_2c, 5);
     int16_t out;
     int16_t sign;
     uint32_t out_en;
@@ -1156,11 +1056,9 @@ static void RN_ChOutput(RN_Chip *chip)
     }
 }
 
-static void RN_FMGenerate(RN_Chip *chip)
+/* Operator output from its 10 bit phase and envelope attenuation */
+static int16_t RN_OperatorOutput(uint16_t phase, uint16_t eg_out, uint8_t test_21_4)
 {
-    uint32_t slot = (chip->cycles + 19) % 24;
-    /* Calculate phase */
-    uint16_t phase = (chip->fm_mod[slot] + (chip->pg_phase[slot] >> 10)) & 0x3ff;
     uint16_t quarter;
     uint16_t level;
     int16_t output;
@@ -1174,7 +1072,7 @@ static void RN_FMGenerate(RN_Chip *chip)
     }
     level = logsinrom[quarter];
     /* Apply envelope */
-    level += chip->eg_out[slot] << 2;
+    level += eg_out << 2;
     /* Transform */
     if (level > 0x1fff)
     {
@@ -1183,14 +1081,21 @@ static void RN_FMGenerate(RN_Chip *chip)
     output = ((exprom[(level & 0xff) ^ 0xff] | 0x400) << 2) >> (level >> 8);
     if (phase & 0x200)
     {
-        output = ((~output) ^ (chip->mode_test_21[4] << 13)) + 1;
+        output = ((~output) ^ (test_21_4 << 13)) + 1;
     }
     else
     {
-        output = output ^ (chip->mode_test_21[4] << 13);
+        output = output ^ (test_21_4 << 13);
     }
-    output = SIGN_EXTEND(13, output);
-    chip->fm_out[slot] = output;
+    return SIGN_EXTEND(13, output);
+}
+
+static void RN_FMGenerate(RN_Chip *chip)
+{
+    uint32_t slot = (chip->cycles + 19) % 24;
+    /* Calculate phase */
+    uint16_t phase = (chip->fm_mod[slot] + (chip->pg_phase[slot] >> 10)) & 0x3ff;
+    chip->fm_out[slot] = RN_OperatorOutput(phase, chip->eg_out[slot], RN_FLAG(chip->mode_test_21, 4));
 }
 
 static void RN_DoTimerA(RN_Chip *chip)
@@ -1224,7 +1129,7 @@ static void RN_DoTimerA(RN_Chip *chip)
     }
     chip->timer_a_load_latch = load;
     /* Increase counter */
-    if ((chip->cycles == 1 && chip->timer_a_load_lock) || chip->mode_test_21[2])
+    if ((chip->cycles == 1 && chip->timer_a_load_lock) || RN_FLAG(chip->mode_test_21, 2))
     {
         time++;
     }
@@ -1268,7 +1173,7 @@ static void RN_DoTimerB(RN_Chip *chip)
     {
         chip->timer_b_subcnt++;
     }
-    if ((chip->timer_b_subcnt == 0x10 && chip->timer_b_load_lock) || chip->mode_test_21[2])
+    if ((chip->timer_b_subcnt == 0x10 && chip->timer_b_load_lock) || RN_FLAG(chip->mode_test_21, 2))
     {
         time++;
     }
@@ -1292,109 +1197,852 @@ static void RN_KeyOn(RN_Chip *chip)
     uint32_t slot = chip->cycles;
     uint32_t chan = chip->channel;
     /* Key On */
-    chip->eg_kon_latch[slot] = chip->mode_kon[slot];
-    chip->eg_kon_csm[slot] = 0;
+    RN_SET_FLAG(chip->eg_kon_latch, slot, RN_FLAG(chip->mode_kon, slot));
+    RN_SET_FLAG(chip->eg_kon_csm, slot, 0);
     if (chip->channel == 2 && chip->mode_kon_csm)
     {
         /* CSM Key On */
-        chip->eg_kon_latch[slot] = 1;
-        chip->eg_kon_csm[slot] = 1;
+        RN_SET_FLAG(chip->eg_kon_latch, slot, 1);
+        RN_SET_FLAG(chip->eg_kon_csm, slot, 1);
     }
     if (chip->cycles == chip->mode_kon_channel)
     {
         /* OP1 */
-        chip->mode_kon[chan] = chip->mode_kon_operator[0];
+        RN_SET_FLAG(chip->mode_kon, chan, chip->mode_kon_operator[0]);
         /* OP2 */
-        chip->mode_kon[chan + 12] = chip->mode_kon_operator[1];
+        RN_SET_FLAG(chip->mode_kon, chan + 12, chip->mode_kon_operator[1]);
         /* OP3 */
-        chip->mode_kon[chan + 6] = chip->mode_kon_operator[2];
+        RN_SET_FLAG(chip->mode_kon, chan + 6, chip->mode_kon_operator[2]);
         /* OP4 */
-        chip->mode_kon[chan + 18] = chip->mode_kon_operator[3];
+        RN_SET_FLAG(chip->mode_kon, chan + 18, chip->mode_kon_operator[3]);
     }
 }
 
-RN_Chip *RN_Create(RN_ChipType chip_type)
+/* Queues the mol/mor sums of the last 24 cycles as one output sample. They are stored raw, at most
+   24 x 768, the gain, clamping and output format are applied on dequeue. */
+static inline void RN_EnqueueSample(RN_Chip *chip)
 {
-    RN_Chip *chip = calloc(1, sizeof(RN_Chip));
-    assert(chip);
-    if(chip == NULL) goto error;
+    uint32_t queued = RN_GetQueuedSamplesCount(chip);
+    if(queued >= chip->sample_queue_length / 2) chip->stats.queue_overruns++;
+    else if(queued + 1 > chip->stats.queue_high_water) chip->stats.queue_high_water = queued + 1;
 
-    chip->chip_type = chip_type;
+    int16_t *next_sample = chip->sample_queue + ((chip->sample_enqueue_position * 2) & (chip->sample_queue_length - 1));
 
-    chip->sample_queue = calloc(RN_SAMPLE_QUEUE_LENGTH, sizeof(int16_t) * 2);
-    assert(chip->sample_queue);
-    if(chip->sample_queue == NULL) goto error;
+    next_sample[0] = (int16_t)chip->current_sample[0];
+    next_sample[1] = (int16_t)chip->current_sample[1];
 
-    chip->write_queue = calloc(RN_WRITE_QUEUE_LENGTH, sizeof(ScheduledWrite));
-    assert(chip->sample_queue);
-    if(chip->sample_queue == NULL) goto error;
+    chip->current_sample[0] = 0;
+    chip->current_sample[1] = 0;
 
-    RN_Reset(chip);
+    chip->sample_enqueue_position++;
+    chip->stats.samples_produced++;
+}
 
-    return chip;
+/* Per-sample engine (RNCM_FAST)
+   Computes a whole 24 cycle frame at once, operator by operator, with the register decoding, tables and
+   arithmetic of the pipeline above but none of its per-cycle latching. Operators are still evaluated in
+   the pipeline order (OP1, OP3, OP2, OP4) so the modulation delays match the chip. Key on, timer control
+   and DAC writes keep their cycle timing, other writes take effect at the end of the frame they land in.
+   The test registers are ignored and the busy flag never sets. */
 
-    error:
-    RN_Destroy(chip);
-    return NULL;
+/* Channel 6 output for one of its 4 cycles, INT16_MIN when the FM channel plays instead of the DAC */
+static int16_t RN_FastDacValue(const RN_Chip *chip)
+{
+    int16_t out = (int16_t)chip->dacdata;
+    return chip->dacen ? SIGN_EXTEND(8, out) : INT16_MIN;
 }
 
-void RN_Destroy(RN_Chip *chip)
+/* Keeps the DAC value of the cycles already output this frame before a DAC register write */
+static void RN_FastDacLatch(RN_Chip *chip)
 {
-    if(chip == NULL) return;
-    if(chip->sample_queue != NULL) free(chip->sample_queue);
-    if(chip->write_queue != NULL) free(chip->write_queue);
-
-    free(chip);
+    uint32_t cycle;
+    for (cycle = 4; cycle < 8 && cycle <= chip->cycles; cycle++)
+    {
+        if (!(chip->fast_dac_latched & (1 << (cycle - 4))))
+        {
+            chip->fast_dac[cycle - 4] = RN_FastDacValue(chip);
+            chip->fast_dac_latched |= 1 << (cycle - 4);
+        }
+    }
 }
 
-size_t RN_GetSize(void)
+/* Latches the last key on/off write into its channel, the core does this on the channel's cycle of every frame */
+static void RN_FastKeyOn(RN_Chip *chip)
 {
-    return sizeof(RN_Chip);
+    uint32_t channel = chip->mode_kon_channel;
+    if (channel == 0xff)
+    {
+        return;
+    }
+    RN_SET_FLAG(chip->mode_kon, channel, chip->mode_kon_operator[0]);
+    RN_SET_FLAG(chip->mode_kon, channel + 12, chip->mode_kon_operator[1]);
+    RN_SET_FLAG(chip->mode_kon, channel + 6, chip->mode_kon_operator[2]);
+    RN_SET_FLAG(chip->mode_kon, channel + 18, chip->mode_kon_operator[3]);
 }
 
-void RN_Reset(RN_Chip *chip)
+static void RN_FastWrite(RN_Chip *chip, uint32_t port, uint8_t data)
 {
-    uint32_t i;
-    RN_ChipType saved_chip_type = chip->chip_type;
-    int16_t *saved_sample_queue = chip->sample_queue;
-    ScheduledWrite *saved_write_queue = chip->write_queue;
+    uint32_t address = chip->write_fm_mode_a;
+    uint32_t channel;
+    uint32_t slot;
+    uint32_t elapsed = chip->fast_cycle - chip->fast_write_cycle;
 
-    memset(chip, 0, sizeof(RN_Chip));
+    /* The write strobes are edge triggered, a write on the cycle right after another one is lost */
+    if (elapsed > 8)
+    {
+        elapsed = 8;
+    }
+    chip->fast_write_cycle = chip->fast_cycle;
+    chip->write_a <<= elapsed;
+    chip->write_d <<= elapsed;
 
-    chip->chip_type = saved_chip_type;
-    chip->sample_queue = saved_sample_queue;
-    chip->write_queue = saved_write_queue;
+    /* Any write may change a phase increment, they are rare enough to recompute them all */
+    chip->fast_inc_dirty = 0xffffff;
+    chip->fast_eg_idle = 0;
 
-    for (i = 0; i < 24; i++)
+    port &= 3;
+    if (port & 1)
     {
-        chip->eg_out[i] = 0x3ff;
-        chip->eg_level[i] = 0x3ff;
-        chip->eg_state[i] = eg_num_release;
-        chip->multi[i] = 1;
+        chip->write_d |= 1;
+        if ((chip->write_d & 0x03) != 0x01)
+        {
+            return;
+        }
     }
-    for (i = 0; i < 6; i++)
+    else
     {
-        chip->pan_l[i] = 1;
-        chip->pan_r[i] = 1;
+        chip->write_a |= 1;
+        if ((chip->write_a & 0x03) != 0x01)
+        {
+            return;
+        }
     }
-}
 
-void RN_Clock1(RN_Chip *chip, int16_t *buffer)
-{
-    uint32_t slot = chip->cycles;
-    chip->lfo_inc = chip->mode_test_21[1];
-    chip->pg_read >>= 1;
-    chip->eg_read[1] >>= 1;
-    chip->eg_cycle++;
-    /* Lock envelope generator timer value */
-    if (chip->cycles == 1 && chip->eg_quotient == 2)
+    if (!(port & 1))
     {
-        if (chip->eg_cycle_stop)
+        /* Address */
+        chip->write_fm_mode_a = ((port << 7) & 0x100) | data;
+        chip->write_fm_address = (data & 0xf0) != 0x00;
+        if (chip->write_fm_address)
         {
-            chip->eg_shift_lock = 0;
+            chip->address = chip->write_fm_mode_a;
         }
-        else
-        {
+        return;
+    }
+
+    if (port == 1 && address == 0x27 && chip->cycles >= 2)
+    {
+        /* The timers lock their control bits on cycle 2, later writes wait for the next frame */
+        chip->fast_timer_data = data;
+        chip->fast_timer_pending = 1;
+    }
+    else if (port == 1)
+    {
+        if (address >= 0x2a && address <= 0x2c)
+        {
+            RN_FastDacLatch(chip);
+        }
+        RN_WriteModeRegister(chip, address, data);
+        if (address == 0x28 && chip->cycles < chip->mode_kon_channel)
+        {
+            /* Lands before the channel's cycle, this frame already sees it. Otherwise it waits for the next one. */
+            RN_FastKeyOn(chip);
+        }
+    }
+
+    if (!chip->write_fm_address || (address & 0x03) == 0x03)
+    {
+        return;
+    }
+
+    channel = (address & 0x03) + ((address >> 8) & 0x01) * 3;
+    if ((address & 0xf0) < 0xa0)
+    {
+        slot = channel + ((address & 0x04) ? 6 : 0) + ((address & 0x08) ? 12 : 0);
+        RN_WriteSlotRegister(chip, slot, address & 0xf0, data);
+    }
+    else
+    {
+        RN_WriteChannelRegister(chip, channel, address & 0xfc, data);
+    }
+}
+
+static void RN_FastTimers(RN_Chip *chip)
+{
+    uint8_t overflow = 0;
+    uint8_t load;
+
+    /* Timer A counts every frame */
+    if (chip->timer_a_load_lock)
+    {
+        chip->timer_a_cnt++;
+        if (chip->timer_a_cnt >> 10)
+        {
+            chip->timer_a_cnt = chip->timer_a_reg;
+            overflow = 1;
+        }
+    }
+    load = !chip->timer_a_load_lock && chip->timer_a_load;
+    chip->timer_a_load_lock = chip->timer_a_load;
+    if (load)
+    {
+        chip->timer_a_cnt = chip->timer_a_reg;
+    }
+    if (chip->timer_a_reset)
+    {
+        chip->timer_a_reset = 0;
+        chip->timer_a_overflow_flag = 0;
+    }
+    else
+    {
+        chip->timer_a_overflow_flag |= overflow & chip->timer_a_enable;
+    }
+    /* CSM KeyOn for one frame */
+    chip->mode_kon_csm = chip->mode_csm && (overflow || load);
+
+    /* Timer B counts every 16 frames */
+    overflow = 0;
+    chip->timer_b_subcnt++;
+    if (chip->timer_b_subcnt == 0x10 && chip->timer_b_load_lock)
+    {
+        chip->timer_b_cnt++;
+        if (chip->timer_b_cnt >> 8)
+        {
+            chip->timer_b_cnt = chip->timer_b_reg;
+            overflow = 1;
+        }
+    }
+    chip->timer_b_subcnt &= 0x0f;
+    load = !chip->timer_b_load_lock && chip->timer_b_load;
+    chip->timer_b_load_lock = chip->timer_b_load;
+    if (load)
+    {
+        chip->timer_b_cnt = chip->timer_b_reg;
+    }
+    if (chip->timer_b_reset)
+    {
+        chip->timer_b_reset = 0;
+        chip->timer_b_overflow_flag = 0;
+    }
+    else
+    {
+        chip->timer_b_overflow_flag |= overflow & chip->timer_b_enable;
+    }
+}
+
+static int16_t RN_FastOperator(RN_Chip *chip, uint32_t slot, uint32_t channel, int16_t mod, uint8_t eg_clock)
+{
+    uint32_t fnum = chip->fnum[channel];
+    uint8_t block = chip->block[channel];
+    uint8_t kcode = chip->kcode[channel];
+    uint8_t ssg_eg = chip->ssg_eg[slot];
+    uint8_t ssg_enable = (ssg_eg >> 3) & 0x01;
+    uint8_t okon = RN_FLAG(chip->eg_kon, slot);
+    uint8_t nkon = RN_FLAG(chip->mode_kon, slot);
+    uint8_t kon_csm = 0;
+    uint8_t pgrst = 0, repeat = 0, hold_up = 0, direction = 0, inverse;
+    uint8_t kon_event, koff_event, eg_off, pg_reset;
+    uint8_t state = chip->eg_state[slot];
+    uint8_t nextstate = state;
+    uint8_t rate_sel, eg_rate, rate, ratemax = 0, inc = 0;
+    uint16_t eg_out;
+    int16_t level = (int16_t)chip->eg_level[slot];
+    int16_t nextlevel, ssg_level, step = 0;
+    int16_t output;
+
+    /* Channel 3 special mode */
+    if (chip->mode_ch3 && channel == 2 && slot != 20)
+    {
+        uint32_t index = slot == 2 ? 1 : slot == 8 ? 0 : 2;
+        fnum = chip->fnum_3ch[index];
+        block = chip->block_3ch[index];
+        kcode = chip->kcode_3ch[index];
+    }
+
+    /* Key On, OP1 latches before a key on/off write reaches it and sees the write a frame later */
+    if (slot < 6)
+    {
+        nkon = RN_FLAG(chip->eg_kon_latch, slot);
+        RN_SET_FLAG(chip->eg_kon_latch, slot, RN_FLAG(chip->mode_kon, slot));
+    }
+    if (channel == 2 && chip->mode_kon_csm)
+    {
+        nkon = 1;
+        kon_csm = 1;
+    }
+
+    /* SSG-EG */
+    if (ssg_enable)
+    {
+        direction = RN_FLAG(chip->eg_ssg_dir, slot);
+        if (level & 0x200)
+        {
+            pgrst = (ssg_eg & 0x03) == 0x00;
+            repeat = (ssg_eg & 0x01) == 0x00;
+            if ((ssg_eg & 0x03) == 0x02)
+            {
+                direction ^= 1;
+            }
+            if ((ssg_eg & 0x03) == 0x03)
+            {
+                direction = 1;
+            }
+        }
+        hold_up = nkon && ((ssg_eg & 0x07) == 0x05 || (ssg_eg & 0x07) == 0x03);
+        direction &= okon;
+    }
+    RN_SET_FLAG(chip->eg_ssg_dir, slot, direction);
+    inverse = (direction ^ ((ssg_eg >> 2) & ssg_enable)) & okon;
+
+    pg_reset = (nkon && !okon) || pgrst;
+    kon_event = (nkon && !okon) || (okon && repeat);
+    koff_event = okon && !nkon;
+
+    /* Rate, only needed to step the envelope or for the instant attack check */
+    if (eg_clock || kon_event)
+    {
+        rate_sel = kon_event ? eg_num_attack : state;
+        switch (rate_sel)
+        {
+        case eg_num_attack:
+            eg_rate = chip->ar[slot];
+            break;
+        case eg_num_decay:
+            eg_rate = chip->dr[slot];
+            break;
+        case eg_num_sustain:
+            eg_rate = chip->sr[slot];
+            break;
+        default:
+            eg_rate = (chip->rr[slot] << 1) | 0x01;
+            break;
+        }
+        rate = (eg_rate << 1) + (kcode >> (chip->ks[slot] ^ 0x03));
+        if (rate > 0x3f)
+        {
+            rate = 0x3f;
+        }
+        if (eg_clock && eg_rate != 0)
+        {
+            inc = RN_EnvelopeIncrement(rate, chip->eg_shift_lock, chip->eg_timer_low_lock);
+        }
+        ratemax = (rate >> 1) == 0x1f;
+    }
+
+    /* Attenuation, from the level before this frame's step */
+    eg_out = level;
+    if (inverse)
+    {
+        eg_out = 512 - level;
+    }
+    eg_out &= 0x3ff;
+    if (RN_FLAG(chip->am, slot))
+    {
+        eg_out += chip->lfo_am >> eg_am_shift[chip->ams[channel]];
+    }
+    if (!(chip->mode_csm && channel == 2))
+    {
+        eg_out += chip->tl[slot] << 3;
+    }
+    if (eg_out > 0x3ff)
+    {
+        eg_out = 0x3ff;
+    }
+    chip->eg_out[slot] = eg_out;
+
+    /* ADSR, as RN_EnvelopeADSR. Between envelope clocks a settled operator has nothing to update. */
+    if (eg_clock || kon_event || koff_event || ssg_enable || kon_csm || !(chip->fast_eg_idle & (1 << slot)))
+    {
+        ssg_level = level;
+        if (inverse)
+        {
+            ssg_level = (512 - level) & 0x3ff;
+        }
+        if (koff_event)
+        {
+            level = ssg_level;
+        }
+        if (ssg_enable)
+        {
+            eg_off = level >> 9;
+        }
+        else
+        {
+            eg_off = (level & 0x3f0) == 0x3f0;
+        }
+        nextlevel = level;
+        if (kon_event)
+        {
+            nextstate = eg_num_attack;
+            if (ratemax)
+            {
+                nextlevel = 0;
+            }
+            else if (state == eg_num_attack && level != 0 && inc && nkon)
+            {
+                step = (~level << inc) >> 5;
+            }
+        }
+        else
+        {
+            switch (state)
+            {
+            case eg_num_attack:
+                if (level == 0)
+                {
+                    nextstate = eg_num_decay;
+                }
+                else if (inc && !ratemax && nkon)
+                {
+                    step = (~level << inc) >> 5;
+                }
+                break;
+            case eg_num_decay:
+                if ((level >> 4) == (chip->sl[slot] << 1))
+                {
+                    nextstate = eg_num_sustain;
+                }
+                else if (!eg_off && inc)
+                {
+                    step = 1 << (inc - 1);
+                    if (ssg_enable)
+                    {
+                        step <<= 2;
+                    }
+                }
+                break;
+            default:
+                if (!eg_off && inc)
+                {
+                    step = 1 << (inc - 1);
+                    if (ssg_enable)
+                    {
+                        step <<= 2;
+                    }
+                }
+                break;
+            }
+            if (!nkon)
+            {
+                nextstate = eg_num_release;
+            }
+        }
+        if (kon_csm)
+        {
+            nextlevel |= chip->tl[slot] << 3;
+        }
+        if (!kon_event && !hold_up && state != eg_num_attack && eg_off)
+        {
+            nextstate = eg_num_release;
+            nextlevel = 0x3ff;
+        }
+        nextlevel += step;
+
+        RN_SET_FLAG(chip->eg_kon, slot, nkon);
+        chip->eg_level[slot] = (uint16_t)nextlevel & 0x3ff;
+        chip->eg_state[slot] = nextstate;
+
+        if (!eg_clock && !kon_event && !koff_event && chip->eg_level[slot] == (uint16_t)level && nextstate == state)
+        {
+            chip->fast_eg_idle |= 1 << slot;
+        }
+    }
+
+    /* Output, then step the phase */
+    output = 0;
+    if (eg_out < 0x340)
+    {
+        /* Quieter operators shift the whole exp table out */
+        output = RN_OperatorOutput((mod + (chip->pg_phase[slot] >> 10)) & 0x3ff, eg_out, 0);
+    }
+    /* Even on a reset, fast_inc_dirty is cleared after the frame and a skipped update would keep the old increment */
+    if (chip->fast_inc_dirty & (1 << slot))
+    {
+        chip->pg_inc[slot] = RN_PhaseIncrement(fnum, block, kcode, chip->lfo_pm, chip->pms[channel], chip->dt[slot], chip->multi[slot]);
+    }
+    if (pg_reset)
+    {
+        chip->pg_phase[slot] = 0;
+    }
+    else
+    {
+        chip->pg_phase[slot] += chip->pg_inc[slot];
+        chip->pg_phase[slot] &= 0xfffff;
+    }
+    chip->fm_out[slot] = output;
+    return output;
+}
+
+static void RN_FastChannel(RN_Chip *chip, uint32_t channel, uint8_t eg_clock)
+{
+    uint8_t connect = chip->connect[channel];
+    int16_t out[4];
+    int16_t mod;
+    int16_t acc = 0;
+    uint32_t op;
+
+    /* The modulators are the latest outputs the pipeline has latched: OP1 and OP3 see the previous frame,
+       OP2 sees this frame's OP1, OP4 this frame's OP1 and OP3 but the previous OP2 */
+    mod = RN_FMModulation(chip, 0, channel, chip->fm_out[channel + 12]);
+    out[0] = RN_FastOperator(chip, channel, channel, mod, eg_clock);
+    mod = RN_FMModulation(chip, 1, channel, chip->fm_out[channel + 18]);
+    out[1] = RN_FastOperator(chip, channel + 6, channel, mod, eg_clock);
+    mod = RN_FMModulation(chip, 2, channel, out[0]);
+    chip->fm_op1[channel][1] = chip->fm_op1[channel][0];
+    chip->fm_op1[channel][0] = out[0];
+    out[2] = RN_FastOperator(chip, channel + 12, channel, mod, eg_clock);
+    mod = RN_FMModulation(chip, 3, channel, out[1]);
+    chip->fm_op2[channel] = out[2];
+    out[3] = RN_FastOperator(chip, channel + 18, channel, mod, eg_clock);
+
+    /* Accumulate */
+    for (op = 0; op < 4; op++)
+    {
+        if (fm_algorithm[op][5][connect])
+        {
+            acc += out[op] >> 5;
+            acc = CLAMP(acc, -256, 255);
+        }
+    }
+    chip->fast_ch_out[2][channel] = chip->fast_ch_out[1][channel];
+    chip->fast_ch_out[1][channel] = chip->fast_ch_out[0][channel];
+    chip->fast_ch_out[0][channel] = acc;
+}
+
+/* mol/mor of one output cycle of a channel, cycle 0 to 3 within its 4 */
+static void RN_FastOutputCycle(const RN_Chip *chip, uint32_t channel, int16_t out, uint32_t cycle, int32_t *left, int32_t *right)
+{
+    if (chip->chip_type & RNCM_YM2612)
+    {
+        int16_t sign = out >> 8;
+        if (out >= 0)
+        {
+            out++;
+            sign++;
+        }
+        *left += chip->pan_l[channel] && cycle == 3 ? out : sign;
+        *right += chip->pan_r[channel] && cycle == 3 ? out : sign;
+    }
+    else if (cycle != 0)
+    {
+        *left += chip->pan_l[channel] ? out : 0;
+        *right += chip->pan_r[channel] ? out : 0;
+    }
+}
+
+/* Runs one frame and returns the sum of its 24 mol/mor outputs, and per channel in stems unless NULL */
+static void RN_FastFrame(RN_Chip *chip, int32_t *sample, int32_t (*stems)[2])
+{
+    uint32_t channel;
+    uint8_t eg_clock;
+    int32_t left = 0;
+    int32_t right = 0;
+
+    /* LFO, sampled at the start of the frame and stepped once per frame */
+    if (chip->lfo_pm != chip->lfo_cnt >> 2)
+    {
+        chip->fast_inc_dirty = 0xffffff;
+    }
+    chip->lfo_pm = chip->lfo_cnt >> 2;
+    if (chip->lfo_cnt & 0x40)
+    {
+        chip->lfo_am = chip->lfo_cnt & 0x3f;
+    }
+    else
+    {
+        chip->lfo_am = chip->lfo_cnt ^ 0x3f;
+    }
+    chip->lfo_am <<= 1;
+    if ((chip->lfo_quotient & lfo_cycles[chip->lfo_freq]) == lfo_cycles[chip->lfo_freq])
+    {
+        chip->lfo_quotient = 0;
+        chip->lfo_cnt++;
+    }
+    chip->lfo_quotient++;
+    chip->lfo_cnt &= chip->lfo_en;
+
+    /* Envelope timer, the envelopes step every third frame with the shift locked on the previous step */
+    chip->eg_quotient = (chip->eg_quotient + 1) % 3;
+    eg_clock = chip->eg_quotient == 2;
+    if (eg_clock)
+    {
+        chip->fast_eg_idle = 0;
+        uint32_t bit;
+        for (bit = 0; bit < 11 && !((chip->eg_timer >> bit) & 0x01); bit++);
+        chip->eg_shift_lock = bit < 11 ? bit + 1 : 0;
+        chip->eg_timer_low_lock = chip->eg_timer & 0x03;
+        chip->eg_timer = (chip->eg_timer + 1) & 0xfff;
+        if (chip->eg_timer == 0)
+        {
+            /* The serial adder carries into bit 0 */
+            chip->eg_timer = 1;
+        }
+    }
+
+    RN_FastTimers(chip);
+    if (chip->fast_timer_pending)
+    {
+        chip->fast_timer_pending = 0;
+        RN_WriteModeRegister(chip, 0x27, chip->fast_timer_data);
+    }
+
+    for (channel = 0; channel < 6; channel++)
+    {
+        RN_FastChannel(chip, channel, eg_clock);
+    }
+    chip->fast_inc_dirty = 0;
+    RN_FastKeyOn(chip);
+
+    /* Each channel drives the DAC for 4 of the 24 cycles, channel 6 is replaced by the DAC when enabled.
+       Channels 2, 4 and 6 are locked before their accumulation finishes and come out a frame later. */
+    int32_t dac_left = 0;
+    int32_t dac_right = 0;
+    for (channel = 0; channel < 6; channel++)
+    {
+        int16_t out = chip->fast_ch_out[1 + (channel & 1)][channel];
+        int32_t ch_left = 0;
+        int32_t ch_right = 0;
+        if (channel == 5 && (chip->dacen || chip->fast_dac_latched))
+        {
+            /* The DAC register is read live on cycles 4 to 7, writes may land in between */
+            uint32_t cycle;
+            for (cycle = 0; cycle < 4; cycle++)
+            {
+                int16_t dac = chip->fast_dac_latched & (1 << cycle) ? chip->fast_dac[cycle] : RN_FastDacValue(chip);
+                if (dac == INT16_MIN)
+                {
+                    RN_FastOutputCycle(chip, channel, out, cycle, &ch_left, &ch_right);
+                }
+                else
+                {
+                    RN_FastOutputCycle(chip, channel, dac, cycle, &dac_left, &dac_right);
+                }
+            }
+            chip->fast_dac_latched = 0;
+        }
+        else if (chip->chip_type & RNCM_YM2612)
+        {
+            /* Output on 1 cycle, the ladder effect offset on all 4 */
+            int16_t sign = out >> 8;
+            if (out >= 0)
+            {
+                out++;
+                sign++;
+            }
+            ch_left = (chip->pan_l[channel] ? out : sign) + sign * 3;
+            ch_right = (chip->pan_r[channel] ? out : sign) + sign * 3;
+        }
+        else
+        {
+            /* Output on 3 cycles */
+            ch_left = chip->pan_l[channel] ? out * 3 : 0;
+            ch_right = chip->pan_r[channel] ? out * 3 : 0;
+        }
+
+        left += ch_left;
+        right += ch_right;
+        if (stems)
+        {
+            stems[channel][0] = ch_left;
+            stems[channel][1] = ch_right;
+        }
+    }
+    left += dac_left;
+    right += dac_right;
+
+    if (chip->chip_type & RNCM_YM2612)
+    {
+        left *= 3;
+        right *= 3;
+    }
+
+    sample[0] = left;
+    sample[1] = right;
+
+    if (stems)
+    {
+        stems[6][0] = dac_left;
+        stems[6][1] = dac_right;
+        for (channel = 0; channel < RN_STEM_COUNT && (chip->chip_type & RNCM_YM2612); channel++)
+        {
+            stems[channel][0] *= 3;
+            stems[channel][1] *= 3;
+        }
+    }
+}
+
+static void RN_FastClock1(RN_Chip *chip, int16_t *buffer)
+{
+    chip->fast_cycle++;
+    if (++chip->cycles == 24)
+    {
+        int32_t sample[2];
+        RN_FastFrame(chip, sample, NULL);
+
+        /* The frame average stands in for the per-cycle output */
+        chip->mol = (int16_t)(sample[0] / 24);
+        chip->mor = (int16_t)(sample[1] / 24);
+        chip->cycles = 0;
+    }
+    chip->channel = chip->cycles % 6;
+
+    buffer[0] = chip->mol;
+    buffer[1] = chip->mor;
+
+    if (chip->status_time)
+        chip->status_time--;
+
+    chip->stats.cycles++;
+}
+
+#ifndef RN_ISA
+/* Layout of a chip block: the chip, then both queues, each starting on a cache line */
+#define RN_BLOCK_ALIGN(size) (((size) + 63) & ~(size_t)63)
+#define RN_BLOCK_SAMPLE_QUEUE RN_BLOCK_ALIGN(sizeof(RN_Chip))
+
+/* Queue lengths of a configuration, 0 unless a power of two */
+static uint32_t RN_ConfigSampleQueue(const RN_Config *config)
+{
+    uint32_t length = config->sample_queue_length ? config->sample_queue_length : RN_SAMPLE_QUEUE_LENGTH;
+    return length >= 2 && (length & (length - 1)) == 0 ? length : 0;
+}
+
+static uint32_t RN_ConfigWriteQueue(const RN_Config *config)
+{
+    uint32_t length = config->write_queue_length ? config->write_queue_length : RN_WRITE_QUEUE_LENGTH;
+    return (length & (length - 1)) == 0 ? length : 0;
+}
+
+static size_t RN_BlockWriteQueue(uint32_t sample_queue_length)
+{
+    return RN_BLOCK_SAMPLE_QUEUE + RN_BLOCK_ALIGN(sample_queue_length * sizeof(int16_t));
+}
+
+size_t RN_GetRequiredSize(const RN_Config *config)
+{
+    uint32_t sample_queue_length = RN_ConfigSampleQueue(config);
+    uint32_t write_queue_length = RN_ConfigWriteQueue(config);
+
+    if(sample_queue_length == 0 || write_queue_length == 0) return 0;
+    return RN_BlockWriteQueue(sample_queue_length) + write_queue_length * sizeof(ScheduledWrite);
+}
+
+RN_Chip *RN_InitInPlace(void *memory, const RN_Config *config)
+{
+    RN_Chip *chip = memory;
+
+    if(memory == NULL || (uintptr_t)memory % RN_CHIP_ALIGNMENT != 0 || RN_GetRequiredSize(config) == 0) return NULL;
+
+    memset(memory, 0, RN_GetRequiredSize(config));
+
+    chip->chip_type = config->chip_type;
+#ifdef RN_REFERENCE
+    chip->kernels = &RN_KERNELS;
+#else
+    chip->kernels = RN_SelectKernels();
+#endif
+    chip->sample_queue = (int16_t *)((uint8_t *)memory + RN_BLOCK_SAMPLE_QUEUE);
+    chip->sample_queue_length = RN_ConfigSampleQueue(config);
+    chip->write_queue = (ScheduledWrite *)((uint8_t *)memory + RN_BlockWriteQueue(chip->sample_queue_length));
+    chip->write_queue_length = RN_ConfigWriteQueue(config);
+
+    RN_Reset(chip);
+
+    return chip;
+}
+
+RN_Chip *RN_Create(RN_ChipType chip_type)
+{
+    RN_Config config = { chip_type, 0, 0 };
+    void *memory = malloc(RN_GetRequiredSize(&config));
+    RN_Chip *chip;
+
+    assert(memory);
+    if(memory == NULL) return NULL;
+
+    chip = RN_InitInPlace(memory, &config);
+    chip->owns_memory = 1;
+
+    return chip;
+}
+
+void RN_Destroy(RN_Chip *chip)
+{
+    if(chip == NULL) return;
+    if(chip->trace != NULL) RN_TraceEnd(chip);
+    if(chip->pin_dump != NULL) RN_PinDumpEnd(chip);
+    if(chip->taps != NULL) RN_TapsEnd(chip);
+
+    /* In-place chips belong to the caller */
+    if(chip->owns_memory) free(chip);
+}
+
+void RN_Reset(RN_Chip *chip)
+{
+    uint32_t i;
+    RN_ChipType saved_chip_type = chip->chip_type;
+    const RN_Kernels *saved_kernels = chip->kernels;
+    uint8_t saved_owns_memory = chip->owns_memory;
+    int16_t *saved_sample_queue = chip->sample_queue;
+    uint32_t saved_sample_queue_length = chip->sample_queue_length;
+    ScheduledWrite *saved_write_queue = chip->write_queue;
+    uint32_t saved_write_queue_length = chip->write_queue_length;
+    RN_Trace *saved_trace = chip->trace;
+    RN_PinDump *saved_pin_dump = chip->pin_dump;
+    int16_t *saved_pin_dump_next = chip->pin_dump_next;
+    int16_t *saved_pin_dump_end = chip->pin_dump_end;
+    RN_Taps *saved_taps = chip->taps;
+
+    if (saved_trace) RN_TraceRecord(saved_trace, RN_TRACE_RESET, 0, 0);
+
+    memset(chip, 0, sizeof(RN_Chip));
+
+    chip->chip_type = saved_chip_type;
+    chip->kernels = saved_kernels;
+    chip->owns_memory = saved_owns_memory;
+    chip->sample_queue = saved_sample_queue;
+    chip->sample_queue_length = saved_sample_queue_length;
+    chip->write_queue = saved_write_queue;
+    chip->write_queue_length = saved_write_queue_length;
+    chip->trace = saved_trace;
+    chip->pin_dump = saved_pin_dump;
+    chip->pin_dump_next = saved_pin_dump_next;
+    chip->pin_dump_end = saved_pin_dump_end;
+    chip->taps = saved_taps;
+
+    for (i = 0; i < 24; i++)
+    {
+        chip->eg_out[i] = 0x3ff;
+        chip->eg_level[i] = 0x3ff;
+        chip->eg_state[i] = eg_num_release;
+        chip->multi[i] = 1;
+    }
+    for (i = 0; i < 6; i++)
+    {
+        chip->pan_l[i] = 1;
+        chip->pan_r[i] = 1;
+    }
+    chip->fast_inc_dirty = 0xffffff;
+}
+#endif
+
+static void RN_DoClock1(RN_Chip *chip, int16_t *buffer)
+{
+    RN_PROFILE_START();
+    uint32_t slot = chip->cycles;
+    chip->lfo_inc = RN_FLAG(chip->mode_test_21, 1);
+    chip->pg_read >>= 1;
+    chip->eg_read[1] >>= 1;
+    chip->eg_cycle++;
+    /* Lock envelope generator timer value */
+    if (chip->cycles == 1 && chip->eg_quotient == 2)
+    {
+        if (chip->eg_cycle_stop)
+        {
+            chip->eg_shift_lock = 0;
+        }
+        else
+        {
             chip->eg_shift_lock = chip->eg_shift + 1;
         }
         chip->eg_timer_low_lock = chip->eg_timer & 0x03;
@@ -1441,32 +2089,41 @@ void RN_Clock1(RN_Chip *chip, int16_t *buffer)
         chip->lfo_inc |= 1;
         break;
     }
-    chip->eg_timer &= ~(chip->mode_test_21[5] << chip->eg_cycle);
+    chip->eg_timer &= ~(RN_FLAG(chip->mode_test_21, 5) << chip->eg_cycle);
     if (((chip->eg_timer >> chip->eg_cycle) | (chip->pin_test_in & chip->eg_custom_timer)) & chip->eg_cycle_stop)
     {
         chip->eg_shift = chip->eg_cycle;
         chip->eg_cycle_stop = 0;
     }
 
+    RN_PROFILE_LAP(chip, RN_STAGE_OTHER);
+
     RN_DoIO(chip);
+    RN_PROFILE_LAP(chip, RN_STAGE_IO);
 
     RN_DoTimerA(chip);
     RN_DoTimerB(chip);
+    RN_PROFILE_LAP(chip, RN_STAGE_TIMERS);
     RN_KeyOn(chip);
+    RN_PROFILE_LAP(chip, RN_STAGE_KEY_ON);
 
     RN_ChOutput(chip);
     RN_ChGenerate(chip);
+    RN_PROFILE_LAP(chip, RN_STAGE_CHANNEL);
 
     RN_FMPrepare(chip);
     RN_FMGenerate(chip);
+    RN_PROFILE_LAP(chip, RN_STAGE_FM);
 
     RN_PhaseGenerate(chip);
     RN_PhaseCalcIncrement(chip);
+    RN_PROFILE_LAP(chip, RN_STAGE_PHASE);
 
     RN_EnvelopeADSR(chip);
     RN_EnvelopeGenerate(chip);
     RN_EnvelopeSSGEG(chip);
     RN_EnvelopePrepare(chip);
+    RN_PROFILE_LAP(chip, RN_STAGE_ENVELOPE);
 
     /* Prepare fnum & block */
     if (chip->mode_ch3)
@@ -1504,8 +2161,12 @@ void RN_Clock1(RN_Chip *chip, int16_t *buffer)
         chip->pg_kcode = chip->kcode[(chip->channel + 1) % 6];
     }
 
+    RN_PROFILE_LAP(chip, RN_STAGE_OTHER);
+
     RN_UpdateLFO(chip);
+    RN_PROFILE_LAP(chip, RN_STAGE_LFO);
     RN_DoRegWrite(chip);
+    RN_PROFILE_LAP(chip, RN_STAGE_REG_WRITE);
     chip->cycles = (chip->cycles + 1) % 24;
     chip->channel = chip->cycles % 6;
 
@@ -1514,10 +2175,29 @@ void RN_Clock1(RN_Chip *chip, int16_t *buffer)
 
     if (chip->status_time)
         chip->status_time--;
+
+    if(chip->pin_dump_next != chip->pin_dump_end)
+    {
+        chip->pin_dump_next[0] = buffer[0];
+        chip->pin_dump_next[1] = buffer[1];
+        chip->pin_dump_next += 2;
+    }
+
+    chip->stats.cycles++;
+#ifdef RN_PROFILING
+    chip->profile.cycles++;
+#endif
+    RN_PROFILE_LAP(chip, RN_STAGE_OTHER);
 }
 
-void RN_Write(RN_Chip *chip, uint32_t port, uint8_t data)
+static void RN_DoWrite(RN_Chip *chip, uint32_t port, uint8_t data)
 {
+    if (chip->chip_type & RNCM_FAST)
+    {
+        RN_FastWrite(chip, port, data);
+        return;
+    }
+
     port &= 3;
     chip->write_data = ((port << 7) & 0x100) | data;
     if (port & 1)
@@ -1532,14 +2212,23 @@ void RN_Write(RN_Chip *chip, uint32_t port, uint8_t data)
     }
 }
 
+#ifndef RN_ISA
+void RN_Write(RN_Chip *chip, uint32_t port, uint8_t data)
+{
+    if (chip->trace) RN_TraceRecord(chip->trace, RN_TRACE_WRITE, port, data);
+
+    RN_DoWrite(chip, port, data);
+}
+
 void RN_SetTestPin(RN_Chip *chip, uint32_t value)
 {
+    if (chip->trace) RN_TraceRecord(chip->trace, RN_TRACE_TEST_PIN, value & 1, 0);
     chip->pin_test_in = value & 1;
 }
 
 uint32_t RN_ReadTestPin(RN_Chip *chip)
 {
-    if (!chip->mode_test_2c[7])
+    if (!RN_FLAG(chip->mode_test_2c, 7))
     {
         return 0;
     }
@@ -1555,12 +2244,12 @@ uint8_t RN_Read(RN_Chip *chip, uint32_t port)
 {
     if ((port & 3) == 0 || (chip->chip_type & RNCM_READ_MODE))
     {
-        if (chip->mode_test_21[6])
+        if (RN_FLAG(chip->mode_test_21, 6))
         {
             /* Read test data */
             uint32_t slot = (chip->cycles + 18) % 24;
-            uint16_t testdata = ((chip->pg_read & 0x01) << 15) | ((chip->eg_read[chip->mode_test_21[0]] & 0x01) << 14);
-            if (chip->mode_test_2c[4])
+            uint16_t testdata = ((chip->pg_read & 0x01) << 15) | ((chip->eg_read[RN_FLAG(chip->mode_test_21, 0)] & 0x01) << 14);
+            if (RN_FLAG(chip->mode_test_2c, 4))
             {
                 testdata |= chip->ch_read & 0x1ff;
             }
@@ -1568,7 +2257,7 @@ uint8_t RN_Read(RN_Chip *chip, uint32_t port)
             {
                 testdata |= chip->fm_out[slot] & 0x3fff;
             }
-            if (chip->mode_test_21[7])
+            if (RN_FLAG(chip->mode_test_21, 7))
             {
                 chip->status = testdata & 0xff;
             }
@@ -1590,38 +2279,60 @@ uint8_t RN_Read(RN_Chip *chip, uint32_t port)
             chip->status_time = 40000000;
         }
     }
-    if (chip->status_time)
-    {
-        return chip->status;
-    }
-    return 0;
+    uint8_t result = chip->status_time ? chip->status : 0;
+
+    if (chip->trace) RN_TraceRecord(chip->trace, RN_TRACE_READ, port, result);
+
+    return result;
 }
 
+#endif
+
 static inline uint16_t RN_GetLatchedAddress(const RN_Chip* chip)
 {
     if (!chip->write_fm_address) return 0;
     return (chip->write_fm_mode_a & 0x100) | (chip->address & 0xFF);
 }
 
+#ifndef RN_ISA
 void RN_ScheduleWrite(RN_Chip* chip, uint32_t port, uint8_t data)
 {
-    ScheduledWrite* next_write = chip->write_queue + (chip->write_enqueue_position % RN_WRITE_QUEUE_LENGTH);
+    if(chip->trace) RN_TraceRecord(chip->trace, RN_TRACE_SCHEDULE, port, data);
+
+    chip->stats.writes_scheduled++;
+
+    // A full queue would overwrite writes that haven't been applied yet
+    if(chip->write_enqueue_position - chip->write_dequeue_position >= chip->write_queue_length)
+    {
+        chip->stats.writes_dropped++;
+        return;
+    }
+
+    ScheduledWrite* next_write = chip->write_queue + (chip->write_enqueue_position & (chip->write_queue_length - 1));
     next_write->port = port;
     next_write->data = data;
     chip->write_enqueue_position++;
 }
 
+#endif
+
 static void RN_HandleScheduledWrites(RN_Chip *chip)
 {
+    if(chip->write_dequeue_position != chip->write_enqueue_position && chip->next_write_clocks > 0)
+    {
+        chip->stats.write_stall_cycles++;
+    }
+
     if(chip->next_write_clocks <= 0 && chip->write_dequeue_position != chip->write_enqueue_position)
     {
-        ScheduledWrite* next_write = chip->write_queue + (chip->write_dequeue_position++ % RN_WRITE_QUEUE_LENGTH);
+        ScheduledWrite* next_write = chip->write_queue + (chip->write_dequeue_position++ & (chip->write_queue_length - 1));
 
         if((next_write->port & 1) == 0)
         {
             // write address
-            RN_Write(chip, next_write->port, next_write->data);
+            RN_DoWrite(chip, next_write->port, next_write->data);
             chip->next_write_clocks = 12;
+            chip->stats.writes_applied++;
         }
         else
         {
@@ -1647,11 +2358,16 @@ static void RN_HandleScheduledWrites(RN_Chip *chip)
 
                         // rewind queue
                         chip->write_dequeue_position--;
+
+                        // count each held back write once, not every cycle it waits
+                        if(!chip->note_deferred) chip->stats.key_on_deferred++;
+                        chip->note_deferred = 1;
                         break;
                     }
 
                     // wait at least this many cycles before the next note-on / note-off
                     chip->next_note_clocks = 112;
+                    chip->note_deferred = 0;
                     break;
                 
                 case 0x30 ... 0x9F:   // operator parameters ch 1–3
@@ -1670,7 +2386,11 @@ static void RN_HandleScheduledWrites(RN_Chip *chip)
                     break;
             }
 
-            if(perform_write) RN_Write(chip, next_write->port, next_write->data);
+            if(perform_write)
+            {
+                RN_DoWrite(chip, next_write->port, next_write->data);
+                chip->stats.writes_applied++;
+            }
         }
     }
 
@@ -1678,66 +2398,366 @@ static void RN_HandleScheduledWrites(RN_Chip *chip)
     if(chip->next_note_clocks > 0) chip->next_note_clocks--;
 }
 
-void RN_Clock(RN_Chip *chip, int clock_count)
+/* Runs clock_count cycles, with the stems of every finished frame unless stems is NULL. Returns the frames finished. */
+static uint32_t RN_FastClock(RN_Chip *chip, int clock_count, RN_StemFrames stems)
+{
+    uint32_t frames = 0;
+
+    while(clock_count > 0)
+    {
+        int32_t sample[2];
+        int run = 24 - (int)chip->cycles;
+        if(run > clock_count) run = clock_count;
+
+        // The scheduler keeps its cycle timing, its writes land in the frame being run
+        if(chip->write_dequeue_position != chip->write_enqueue_position || chip->next_write_clocks > 0 || chip->next_note_clocks > 0)
+        {
+            for(int i = 0; i < run; i++)
+            {
+                RN_HandleScheduledWrites(chip);
+                chip->cycles++;
+                chip->fast_cycle++;
+            }
+        }
+        else
+        {
+            chip->cycles += run;
+            chip->fast_cycle += run;
+        }
+
+        chip->stats.cycles += run;
+        chip->status_time = chip->status_time > (uint32_t)run ? chip->status_time - run : 0;
+        clock_count -= run;
+
+        if(chip->cycles == 24)
+        {
+            chip->cycles = 0;
+            if(stems)
+            {
+                int32_t stem_sums[RN_STEM_COUNT][2];
+                RN_FastFrame(chip, sample, stem_sums);
+                for(uint32_t stem = 0; stem < RN_STEM_COUNT; stem++)
+                {
+                    stems[stem][frames * 2] = (int16_t)stem_sums[stem][0];
+                    stems[stem][frames * 2 + 1] = (int16_t)stem_sums[stem][1];
+                }
+            }
+            else
+            {
+                RN_FastFrame(chip, sample, NULL);
+            }
+            chip->current_sample[0] = sample[0];
+            chip->current_sample[1] = sample[1];
+            RN_EnqueueSample(chip);
+            frames++;
+        }
+    }
+    chip->channel = chip->cycles % 6;
+    return frames;
+}
+
+static void RN_KernelClock(RN_Chip *chip, int clock_count)
+{
+    int16_t buffer[2];
+
+    if(chip->chip_type & RNCM_FAST)
+    {
+        RN_FastClock(chip, clock_count, NULL);
+        return;
+    }
+
+    for(int i = 0; i < clock_count; i++)
+    {
+        RN_PROFILE_START();
+        RN_HandleScheduledWrites(chip);
+        RN_PROFILE_LAP(chip, RN_STAGE_SCHEDULER);
+
+        RN_DoClock1(chip, buffer);
+
+        chip->current_sample[0] += buffer[0];
+        chip->current_sample[1] += buffer[1];
+
+        if(chip->cycles == 0)
+        {
+            RN_EnqueueSample(chip);
+        }
+    }
+}
+
+/* Stem of each group of 4 output cycles, by cycles / 4 */
+static const uint8_t stem_of_cycle_group[6] = { 1, 5, 3, 0, 4, 2 };
+
+/* RN_KernelClock that also sums every output cycle into the stem of the channel it belongs to */
+static uint32_t RN_KernelClockStems(RN_Chip *chip, int clock_count, RN_StemFrames stems)
 {
     int16_t buffer[2];
+    uint32_t frames = 0;
+
+    if(chip->chip_type & RNCM_FAST) return RN_FastClock(chip, clock_count, stems);
 
     for(int i = 0; i < clock_count; i++)
     {
+        RN_PROFILE_START();
         RN_HandleScheduledWrites(chip);
+        RN_PROFILE_LAP(chip, RN_STAGE_SCHEDULER);
 
-        RN_Clock1(chip, buffer);
+        // The DAC replaces channel 6 on its cycles, and all of them with test bit 0x2C.5
+        uint32_t group = chip->cycles >> 2;
+        uint32_t stem = (group == 1 && chip->dacen) || RN_FLAG(chip->mode_test_2c, 5) ? 6 : stem_of_cycle_group[group];
+
+        RN_DoClock1(chip, buffer);
 
         chip->current_sample[0] += buffer[0];
         chip->current_sample[1] += buffer[1];
+        chip->stem_sample[stem][0] += buffer[0];
+        chip->stem_sample[stem][1] += buffer[1];
 
         if(chip->cycles == 0)
         {
-            int16_t *next_sample = chip->sample_queue + ((chip->sample_enqueue_position * 2) % RN_SAMPLE_QUEUE_LENGTH);
+            RN_EnqueueSample(chip);
+            for(stem = 0; stem < RN_STEM_COUNT; stem++)
+            {
+                stems[stem][frames * 2] = (int16_t)chip->stem_sample[stem][0];
+                stems[stem][frames * 2 + 1] = (int16_t)chip->stem_sample[stem][1];
+                chip->stem_sample[stem][0] = 0;
+                chip->stem_sample[stem][1] = 0;
+            }
+            frames++;
+        }
+    }
+
+    return frames;
+}
+
+static void RN_KernelClock1(RN_Chip *chip, int16_t *buffer)
+{
+    if (chip->chip_type & RNCM_FAST)
+    {
+        RN_FastClock1(chip, buffer);
+        return;
+    }
+
+    RN_DoClock1(chip, buffer);
+}
+
+/* RN_KernelClock for RN_RenderDecimated, hands out every cycle's output rather than summing it into the queue */
+static void RN_KernelClockCycles(RN_Chip *chip, int clock_count, int16_t *cycles)
+{
+    for(int i = 0; i < clock_count; i++)
+    {
+        RN_PROFILE_START();
+        RN_HandleScheduledWrites(chip);
+        RN_PROFILE_LAP(chip, RN_STAGE_SCHEDULER);
 
-            next_sample[0] = CLAMP(chip->current_sample[0] * RN_GAIN, -32768, 32767);
-            next_sample[1] = CLAMP(chip->current_sample[1] * RN_GAIN, -32768, 32767);
+        RN_KernelClock1(chip, cycles + i * 2);
+    }
+}
+
+/* Filter loop of resample.c, count stereo outputs from the resampler's position on. 8 partial sums per
+   channel let the taps vectorize without reassociating float additions. */
+static void RN_KernelResample(const RN_Resampler *resampler, float *out, uint32_t count)
+{
+    uint32_t taps = resampler->taps;
+    uint64_t position = resampler->position;
 
-            chip->current_sample[0] = 0;
-            chip->current_sample[1] = 0;
+    for(uint32_t i = 0; i < count; i++, position += resampler->step)
+    {
+        const float *left = resampler->history[0] + (position >> 32);
+        const float *right = resampler->history[1] + (position >> 32);
+        uint64_t phase = (uint64_t)(uint32_t)position * resampler->phases;
+        const float *phase0 = resampler->bank + (phase >> 32) * taps;
+        const float *phase1 = phase0 + taps;
+        float mix = (float)(uint32_t)phase * (1.0f / 4294967296.0f);
+        float sum_l[8] = { 0 };
+        float sum_r[8] = { 0 };
 
-            chip->sample_enqueue_position++;
+        for(uint32_t k = 0; k < taps; k += 8)
+        {
+            for(uint32_t j = 0; j < 8; j++)
+            {
+                float coefficient = phase0[k + j] + (phase1[k + j] - phase0[k + j]) * mix;
+                sum_l[j] += left[k + j] * coefficient;
+                sum_r[j] += right[k + j] * coefficient;
+            }
         }
+
+        out[i * 2] = ((sum_l[0] + sum_l[4]) + (sum_l[1] + sum_l[5])) + ((sum_l[2] + sum_l[6]) + (sum_l[3] + sum_l[7]));
+        out[i * 2 + 1] = ((sum_r[0] + sum_r[4]) + (sum_r[1] + sum_r[5])) + ((sum_r[2] + sum_r[6]) + (sum_r[3] + sum_r[7]));
     }
 }
 
+const RN_Kernels RN_KERNELS =
+{
+    RN_KERNELS_NAME,
+    RN_KernelClock,
+    RN_KernelClock1,
+    RN_KernelClockStems,
+    RN_KernelResample,
+    RN_KernelClockCycles
+};
+
+#ifndef RN_ISA
+void RN_Clock1(RN_Chip *chip, int16_t *buffer)
+{
+    if (chip->trace) RN_TraceClock(chip->trace, RN_TRACE_CLOCK1, 1);
+
+    chip->kernels->clock1(chip, buffer);
+}
+
+void RN_Clock(RN_Chip *chip, int clock_count)
+{
+    if(chip->trace && clock_count > 0) RN_TraceClock(chip->trace, RN_TRACE_CLOCK, clock_count);
+
+    if(chip->taps) RN_TapsClock(chip, clock_count);
+    else chip->kernels->clock(chip, clock_count);
+}
+
+void RN_ClockCycles(RN_Chip *chip, int clock_count, int16_t *cycles)
+{
+    if(chip->trace && clock_count > 0) RN_TraceClock(chip->trace, RN_TRACE_CLOCK_CYCLES, clock_count);
+
+    chip->kernels->clock_cycles(chip, clock_count, cycles);
+}
+
 uint32_t RN_GetQueuedSamplesCount(RN_Chip* chip)
 {
     return chip->sample_enqueue_position - chip->sample_dequeue_position;
 }
 
+/* Converts count raw queue samples into the caller's buffers from sample offset on, one loop per format so
+   each vectorizes */
+#define RN_TO_S16(x) (int16_t)CLAMP((x) * RN_GAIN, -32768, 32767)
+#define RN_TO_S32(x) ((int32_t)(x) * RN_GAIN)
+#define RN_TO_F32(x) ((float)(x) * (RN_GAIN / 32768.0f))
+
+#define RN_CONVERT_SAMPLES(type, convert) \
+    if(format & RN_FORMAT_PLANAR) \
+    { \
+        type *out_l = (type *)buffer + offset; \
+        type *out_r = (type *)right + offset; \
+        for(i = 0; i < count; i++) \
+        { \
+            out_l[i] = convert(src[i * 2]); \
+            out_r[i] = convert(src[i * 2 + 1]); \
+        } \
+    } \
+    else \
+    { \
+        type *out = (type *)buffer + offset * 2; \
+        for(i = 0; i < count * 2; i++) out[i] = convert(src[i]); \
+    }
+
+static void RN_ConvertSamples(const int16_t *src, uint32_t count, RN_SampleFormat format, void *buffer, void *right, uint32_t offset)
+{
+    uint32_t i;
+
+    switch(format & ~RN_FORMAT_PLANAR)
+    {
+        case RN_FORMAT_S32:
+            RN_CONVERT_SAMPLES(int32_t, RN_TO_S32);
+            break;
+        case RN_FORMAT_F32:
+            RN_CONVERT_SAMPLES(float, RN_TO_F32);
+            break;
+        default:
+            RN_CONVERT_SAMPLES(int16_t, RN_TO_S16);
+            break;
+    }
+}
+
 uint32_t RN_DequeueSamples(RN_Chip* chip, int16_t* buffer, uint32_t sample_count)
 {
+    return RN_DequeueSamplesFormat(chip, RN_FORMAT_S16, buffer, NULL, sample_count);
+}
+
+uint32_t RN_DequeueSamplesFormat(RN_Chip *chip, RN_SampleFormat format, void *buffer, void *right, uint32_t sample_count)
+{
+    if (chip->trace) RN_TraceDequeue(chip->trace, sample_count);
+
     uint32_t available = RN_GetQueuedSamplesCount(chip);
     uint32_t to_dequeue = (sample_count < available) ? sample_count : available;
-    
+
     if (to_dequeue == 0) return 0;
-    
-    uint32_t queue_samples = RN_SAMPLE_QUEUE_LENGTH / 2;  // Each sample is 2 int16_t (stereo)
-    uint32_t start_pos = chip->sample_dequeue_position % queue_samples;
+
+    uint32_t queue_samples = chip->sample_queue_length / 2;  // Each sample is 2 int16_t (stereo)
+    uint32_t start_pos = chip->sample_dequeue_position & (queue_samples - 1);
     uint32_t samples_until_wrap = queue_samples - start_pos;
-    
-    if (to_dequeue <= samples_until_wrap) {
-        // No wraparound needed - single memcpy
-        int16_t *src = chip->sample_queue + (start_pos * 2);
-        memcpy(buffer, src, to_dequeue * 2 * sizeof(int16_t));
-    } else {
-        // Wraparound - two memcpy calls
-        int16_t *src = chip->sample_queue + (start_pos * 2);
-        
-        // Copy from current position to end of buffer
-        memcpy(buffer, src, samples_until_wrap * 2 * sizeof(int16_t));
-        
-        // Copy remaining samples from beginning of buffer
-        uint32_t remaining = to_dequeue - samples_until_wrap;
-        memcpy(buffer + (samples_until_wrap * 2), chip->sample_queue, remaining * 2 * sizeof(int16_t));
-    }
-    
+    uint32_t first = (to_dequeue < samples_until_wrap) ? to_dequeue : samples_until_wrap;
+
+    // Up to the end of the queue, then the rest from its start
+    RN_ConvertSamples(chip->sample_queue + (start_pos * 2), first, format, buffer, right, 0);
+    if(to_dequeue > first) RN_ConvertSamples(chip->sample_queue, to_dequeue - first, format, buffer, right, first);
+
     chip->sample_dequeue_position += to_dequeue;
+    chip->stats.samples_dequeued += to_dequeue;
     return to_dequeue;
 }
+
+uint32_t RN_ClockStems(RN_Chip *chip, int clock_count, RN_SampleFormat format, void *const *stems)
+{
+    RN_StemFrames frames;
+    uint32_t written = 0;
+    int planar = (format & RN_FORMAT_PLANAR) != 0;
+
+    if(chip->trace && clock_count > 0) RN_TraceClock(chip->trace, RN_TRACE_CLOCK, clock_count);
+
+    /* RN_Clock finished the frame the sums were started in */
+    if(chip->stem_position != chip->sample_enqueue_position) memset(chip->stem_sample, 0, sizeof(chip->stem_sample));
+
+    while(clock_count > 0)
+    {
+        int run = RN_STEM_CHUNK * 24 - (int)chip->cycles;
+        if(run > clock_count) run = clock_count;
+
+        uint32_t count = chip->kernels->clock_stems(chip, run, frames);
+        for(uint32_t stem = 0; stem < RN_STEM_COUNT; stem++)
+        {
+            RN_ConvertSamples(frames[stem], count, format, stems[planar ? stem * 2 : stem], planar ? stems[stem * 2 + 1] : NULL, written);
+        }
+
+        written += count;
+        clock_count -= run;
+    }
+
+    chip->stem_position = chip->sample_enqueue_position;
+    return written;
+}
+
+void RN_GetStats(RN_Chip *chip, RN_Stats *stats)
+{
+    *stats = chip->stats;
+}
+
+void RN_ResetStats(RN_Chip *chip)
+{
+    memset(&chip->stats, 0, sizeof(RN_Stats));
+}
+
+int RN_GetProfile(RN_Chip *chip, RN_Profile *profile)
+{
+#ifdef RN_PROFILING
+    *profile = chip->profile;
+    return 1;
+#else
+    memset(profile, 0, sizeof(RN_Profile));
+    return 0;
+#endif
+}
+
+void RN_ResetProfile(RN_Chip *chip)
+{
+#ifdef RN_PROFILING
+    memset(&chip->profile, 0, sizeof(RN_Profile));
+#endif
+}
+
+const char *RN_GetProfileStageName(RN_ProfileStage stage)
+{
+    static const char *names[RN_STAGE_COUNT] =
+    {
+        "io", "timers", "key-on", "channel", "fm", "phase", "envelope", "lfo", "reg-write", "scheduler", "other"
+    };
+
+    return (unsigned)stage < RN_STAGE_COUNT ? names[stage] : "unknown";
+}
+#endif
@@ -0,0 +1,306 @@
+#ifndef RENUKE_INTERNAL_H
+#define RENUKE_INTERNAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "renuke.h"
+
+typedef struct RN_Trace RN_Trace;
+typedef struct RN_PinDump RN_PinDump;
+
+/* Trace record types (trace.c), the high nibble of the record byte */
+#define RN_TRACE_WRITE    0x10 /* + port, data byte */
+#define RN_TRACE_SCHEDULE 0x20 /* + port, data byte */
+#define RN_TRACE_READ     0x30 /* + port, recorded result byte */
+#define RN_TRACE_TEST_PIN 0x40 /* + value */
+#define RN_TRACE_CLOCK    0x50 /* RN_Clock cycles, varint */
+#define RN_TRACE_CLOCK1   0x60 /* RN_Clock1 calls, varint */
+#define RN_TRACE_DEQUEUE  0x70 /* RN_DequeueSamples request, varint */
+#define RN_TRACE_RESET    0x80
+#define RN_TRACE_CLOCK_CYCLES 0x90 /* RN_ClockCycles cycles, varint */
+
+void RN_TraceRecord(RN_Trace *trace, uint8_t type, uint32_t port, uint8_t data);
+void RN_TraceClock(RN_Trace *trace, uint8_t type, uint32_t count);
+void RN_TraceDequeue(RN_Trace *trace, uint32_t sample_count);
+
+typedef struct
+{
+    uint16_t port;
+    uint8_t data;
+} ScheduledWrite;
+
+/* Output gain, from the raw 24 cycle mol/mor sums to the int16 scale */
+#define RN_GAIN 32
+
+/* Resampler state (resample.c). The history holds the input deinterleaved as floats at the int16 scale, the
+   filter of the next output starts at history index position >> 32 and sits at fraction (uint32_t)position. */
+#define RN_RESAMPLE_BLOCK 256
+struct RN_Resampler
+{
+    const struct RN_Kernels *kernels;
+    uint32_t taps;       /* A multiple of 8 */
+    uint32_t phases;
+    float *bank;         /* phases + 1 rows of taps coefficients */
+    float *history[2];   /* taps + 2 x RN_RESAMPLE_BLOCK each */
+    uint32_t capacity;
+    uint32_t fill;
+    uint64_t position;   /* 32.32 fixed point */
+    uint64_t step;       /* Input samples per output sample, 32.32 fixed point */
+};
+
+/* RN_ResamplerCreate with taps_scale times the taps of the preset, which keeps the transition band as narrow
+   relative to the output rate when decimating. RN_ResamplerProcess with separate input and output formats. */
+RN_Resampler *RN_ResamplerCreateScaled(double in_rate, double out_rate, RN_ResampleQuality quality, uint32_t taps_scale);
+void RN_ResamplerRun(RN_Resampler *resampler, RN_SampleFormat in_format, const void *in, uint32_t *in_count,
+    RN_SampleFormat out_format, void *out, uint32_t *out_count);
+
+/* Frames of raw stem sums per clock_stems call at most, RN_ClockStems converts them in between */
+#define RN_STEM_CHUNK 64
+typedef int16_t RN_StemFrames[RN_STEM_COUNT][RN_STEM_CHUNK * 2];
+
+/* Clock paths of renuke.c and the resampler's filter loop. renuke_isa.c compiles them again for higher ISA levels and RN_Create takes
+   the best table the CPU supports (dispatch.c), the RENUKE_ISA environment variable forces one by name. */
+typedef struct RN_Kernels
+{
+    const char *name;
+    void (*clock)(RN_Chip *chip, int clock_count);
+    void (*clock1)(RN_Chip *chip, int16_t *buffer);
+    uint32_t (*clock_stems)(RN_Chip *chip, int clock_count, RN_StemFrames stems); /* Returns the frames finished */
+    void (*resample)(const RN_Resampler *resampler, float *out, uint32_t count); /* Interleaved, from position on */
+    void (*clock_cycles)(RN_Chip *chip, int clock_count, int16_t *cycles); /* mol/mor of every cycle, nothing queued */
+} RN_Kernels;
+
+extern const RN_Kernels RN_kernels_baseline;
+extern const RN_Kernels RN_kernels_avx2;
+extern const RN_Kernels RN_kernels_avx512;
+
+const RN_Kernels *RN_SelectKernels(void);
+
+/* RN_Clock for the decimator (decimate.c), without the sample queue. Traced as its own record type. */
+void RN_ClockCycles(RN_Chip *chip, int clock_count, int16_t *cycles);
+
+/* The clock path of RN_Clock while taps are on (taps.c) */
+void RN_TapsClock(RN_Chip *chip, int clock_count);
+
+/* Arrays of single bit flags, a byte per flag or with -Dcompact=true a bit of one mask. Only accessed
+   through RN_FLAG and RN_SET_FLAG, the value stored must be 0 or 1. */
+#ifdef RN_COMPACT
+#define RN_FLAGS(name, count) uint32_t name
+#define RN_FLAG(flags, index) (((flags) >> (index)) & 0x01)
+#define RN_SET_FLAG(flags, index, value) ((flags) = ((flags) & ~(1u << (index))) | ((uint32_t)(value) << (index)))
+#else
+#define RN_FLAGS(name, count) uint8_t name[count]
+#define RN_FLAG(flags, index) ((flags)[index])
+#define RN_SET_FLAG(flags, index, value) ((flags)[index] = (value))
+#endif
+
+/* Full structure definition, private to the library and its test harnesses.
+   Everything before chip_type is the emulated chip state compared cycle by cycle by the
+   differential fuzzer (fuzz/) and snapshot by write traces, including the per-sample engine's
+   pipeline and timing state. Values the optimized paths cache and can recompute go after it. */
+struct RN_Chip
+{
+    uint32_t cycles;
+    uint32_t channel;
+    int16_t mol, mor;
+    /* IO */
+    uint16_t write_data;
+    uint8_t write_a;
+    uint8_t write_d;
+    uint8_t write_a_en;
+    uint8_t write_d_en;
+    uint8_t write_busy;
+    uint8_t write_busy_cnt;
+    uint8_t write_fm_address;
+    uint8_t write_fm_data;
+    uint16_t write_fm_mode_a;
+    uint16_t address;
+    uint8_t data;
+    uint8_t pin_test_in;
+    uint8_t pin_irq;
+    uint8_t busy;
+    /* LFO */
+    uint8_t lfo_en;
+    uint8_t lfo_freq;
+    uint8_t lfo_pm;
+    uint8_t lfo_am;
+    uint8_t lfo_cnt;
+    uint8_t lfo_inc;
+    uint8_t lfo_quotient;
+    /* Phase generator */
+    uint16_t pg_fnum;
+    uint8_t pg_block;
+    uint8_t pg_kcode;
+    uint32_t pg_inc[24];
+    uint32_t pg_phase[24];
+    RN_FLAGS(pg_reset, 24);
+    uint32_t pg_read;
+    /* Envelope generator */
+    uint8_t eg_cycle;
+    uint8_t eg_cycle_stop;
+    uint8_t eg_shift;
+    uint8_t eg_shift_lock;
+    uint8_t eg_timer_low_lock;
+    uint16_t eg_timer;
+    uint8_t eg_timer_inc;
+    uint16_t eg_quotient;
+    uint8_t eg_custom_timer;
+    uint8_t eg_rate;
+    uint8_t eg_ksv;
+    uint8_t eg_inc;
+    uint8_t eg_ratemax;
+    uint8_t eg_sl[2];
+    uint8_t eg_lfo_am;
+    uint8_t eg_tl[2];
+    uint8_t eg_state[24];
+    uint16_t eg_level[24];
+    uint16_t eg_out[24];
+    RN_FLAGS(eg_kon, 24);
+    RN_FLAGS(eg_kon_csm, 24);
+    RN_FLAGS(eg_kon_latch, 24);
+    RN_FLAGS(eg_ssg_enable, 24);
+    RN_FLAGS(eg_ssg_pgrst_latch, 24);
+    RN_FLAGS(eg_ssg_repeat_latch, 24);
+    RN_FLAGS(eg_ssg_hold_up_latch, 24);
+    RN_FLAGS(eg_ssg_dir, 24);
+    RN_FLAGS(eg_ssg_inv, 24);
+    uint32_t eg_read[2];
+    uint8_t eg_read_inc;
+    /* FM */
+    int16_t fm_op1[6][2];
+    int16_t fm_op2[6];
+    int16_t fm_out[24];
+    uint16_t fm_mod[24];
+    /* Channel */
+    int16_t ch_acc[6];
+    int16_t ch_out[6];
+    int16_t ch_lock;
+    uint8_t ch_lock_l;
+    uint8_t ch_lock_r;
+    int16_t ch_read;
+    /* Per-sample engine: channel outputs of the last 3 frames, delayed like the frames RN_ChOutput locks
+       them in, and the channel 6 values of the DAC cycles already output when a DAC write landed */
+    int16_t fast_ch_out[3][6];
+    int16_t fast_dac[4];
+    uint8_t fast_dac_latched;
+    /* Timer control write that missed the cycle 2 lock of the frame being run */
+    uint8_t fast_timer_data;
+    uint8_t fast_timer_pending;
+    /* Cycle counter for the write strobe edges */
+    uint32_t fast_cycle;
+    uint32_t fast_write_cycle;
+    /* Timer */
+    uint16_t timer_a_cnt;
+    uint16_t timer_a_reg;
+    uint8_t timer_a_load_lock;
+    uint8_t timer_a_load;
+    uint8_t timer_a_enable;
+    uint8_t timer_a_reset;
+    uint8_t timer_a_load_latch;
+    uint8_t timer_a_overflow_flag;
+    uint8_t timer_a_overflow;
+
+    uint16_t timer_b_cnt;
+    uint8_t timer_b_subcnt;
+    uint16_t timer_b_reg;
+    uint8_t timer_b_load_lock;
+    uint8_t timer_b_load;
+    uint8_t timer_b_enable;
+    uint8_t timer_b_reset;
+    uint8_t timer_b_load_latch;
+    uint8_t timer_b_overflow_flag;
+    uint8_t timer_b_overflow;
+
+    /* Register set */
+    RN_FLAGS(mode_test_21, 8);
+    RN_FLAGS(mode_test_2c, 8);
+    uint8_t mode_ch3;
+    uint8_t mode_kon_channel;
+    uint8_t mode_kon_operator[4];
+    RN_FLAGS(mode_kon, 24);
+    uint8_t mode_csm;
+    uint8_t mode_kon_csm;
+    uint8_t dacen;
+    int16_t dacdata;
+
+    uint8_t ks[24];
+    uint8_t ar[24];
+    uint8_t sr[24];
+    uint8_t dt[24];
+    uint8_t multi[24];
+    uint8_t sl[24];
+    uint8_t rr[24];
+    uint8_t dr[24];
+    RN_FLAGS(am, 24);
+    uint8_t tl[24];
+    uint8_t ssg_eg[24];
+
+    uint16_t fnum[6];
+    uint8_t block[6];
+    uint8_t kcode[6];
+    uint16_t fnum_3ch[6];
+    uint8_t block_3ch[6];
+    uint8_t kcode_3ch[6];
+    uint8_t reg_a4;
+    uint8_t reg_ac;
+    uint8_t connect[6];
+    uint8_t fb[6];
+    uint8_t pan_l[6], pan_r[6];
+    uint8_t ams[6];
+    uint8_t pms[6];
+    uint8_t status;
+    uint32_t status_time;
+
+    /* Chip configuration */
+    RN_ChipType chip_type;
+    const RN_Kernels *kernels;
+    uint8_t owns_memory; /* Allocated by RN_Create rather than placed by RN_InitInPlace */
+
+    /* Per-sample engine caches: slots whose pg_inc needs recomputing and slots whose envelope is
+       settled until the next clock. Everything dirty and nothing idle is always a valid setting. */
+    uint32_t fast_inc_dirty;
+    uint32_t fast_eg_idle;
+    
+    /* Buffered output samples */
+    int32_t current_sample[2];
+    int16_t *sample_queue;
+    uint32_t sample_queue_length; /* int16 values, a power of two */
+    uint32_t sample_enqueue_position;
+    uint32_t sample_dequeue_position;
+
+    /* Per-channel sums of the frame in progress for RN_ClockStems, valid while stem_position matches
+       sample_enqueue_position */
+    int32_t stem_sample[RN_STEM_COUNT][2];
+    uint32_t stem_position;
+
+    // Write scheduling
+    int next_write_clocks;
+    int next_note_clocks;
+    ScheduledWrite* write_queue;
+    uint32_t write_queue_length; /* A power of two */
+    uint32_t write_enqueue_position;
+    uint32_t write_dequeue_position;
+    uint8_t note_deferred;
+
+    RN_Stats stats;
+
+    /* Active write trace, NULL when not tracing */
+    RN_Trace *trace;
+
+    /* Active pin dump (pindump.c), next and end are NULL when not dumping */
+    RN_PinDump *pin_dump;
+    int16_t *pin_dump_next;
+    int16_t *pin_dump_end;
+
+    /* Active taps (taps.c), NULL when off */
+    RN_Taps *taps;
+
+#ifdef RN_PROFILING
+    RN_Profile profile;
+#endif
+};
+
+/* Size of the state compared by the differential fuzzer */
+#define RN_CHIP_STATE_SIZE offsetof(struct RN_Chip, chip_type)
+
+#endif
@@ -0,0 +1,11 @@
+/* The clock paths of renuke.c compiled for one ISA level, RN_ISA and the matching compiler flags are
+   set per level in meson.build. The table is named RN_kernels_<level>, see dispatch.c. */
+#define RN_CONCAT(a, b) RN_CONCAT2(a, b)
+#define RN_CONCAT2(a, b) a##b
+#define RN_STRING(a) RN_STRING2(a)
+#define RN_STRING2(a) #a
+
+#define RN_KERNELS RN_CONCAT(RN_kernels_, RN_ISA)
+#define RN_KERNELS_NAME RN_STRING(RN_ISA)
+
+#include "renuke.c"
@@ -0,0 +1,285 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "renuke.h"
+#include "renuke_internal.h"
+
+/* Windowed-sinc polyphase resampler. The bank holds phases + 1 Kaiser windowed sinc filters of taps
+   coefficients, for fractional input positions 0, 1 / phases ... 1, cut off below the lower of the two
+   Nyquist frequencies. An output blends the two filters around its position (RN_KernelResample, which
+   is compiled per ISA level with the clock paths and picked the same way). */
+
+#define RN_PI 3.14159265358979323846
+
+static const struct
+{
+    uint32_t taps;
+    uint32_t phases;
+    double beta;   /* Kaiser window shape, higher trades a wider transition band for stopband attenuation */
+    double cutoff; /* Of the lower Nyquist frequency, so that the transition band of the window ends at it */
+} presets[] =
+{
+    { 16, 64, 6.0, 0.72 },   /* RN_RESAMPLE_FAST */
+    { 32, 128, 8.0, 0.82 },  /* RN_RESAMPLE_MEDIUM */
+    { 64, 256, 9.5, 0.89 },  /* RN_RESAMPLE_BEST */
+};
+
+/* Zeroth order modified Bessel function of the first kind, for the Kaiser window */
+static double RN_BesselI0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+
+    for(int k = 1; k < 64 && term > sum * 1e-12; k++)
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+
+    return sum;
+}
+
+static void RN_ResamplerBuildBank(RN_Resampler *resampler, double cutoff, double beta)
+{
+    uint32_t taps = resampler->taps;
+    double half = taps / 2;
+    double window_scale = 1.0 / RN_BesselI0(beta);
+
+    for(uint32_t phase = 0; phase <= resampler->phases; phase++)
+    {
+        float *row = resampler->bank + phase * taps;
+        double fraction = (double)phase / resampler->phases;
+        double sum = 0.0;
+
+        for(uint32_t k = 0; k < taps; k++)
+        {
+            /* Distance of tap k from the output position, in input samples */
+            double x = (double)k - (half - 1.0) - fraction;
+            double t = x / half;
+            double sinc = x == 0.0 ? 1.0 : sin(RN_PI * cutoff * x) / (RN_PI * cutoff * x);
+            double window = t * t < 1.0 ? RN_BesselI0(beta * sqrt(1.0 - t * t)) * window_scale : 0.0;
+            double coefficient = cutoff * sinc * window;
+
+            row[k] = (float)coefficient;
+            sum += coefficient;
+        }
+
+        /* Unity gain at DC for every phase, so a constant input gives no phase ripple */
+        for(uint32_t k = 0; k < taps; k++) row[k] = (float)(row[k] / sum);
+    }
+}
+
+RN_Resampler *RN_ResamplerCreateScaled(double in_rate, double out_rate, RN_ResampleQuality quality, uint32_t taps_scale)
+{
+    RN_Resampler *resampler;
+
+    if(!(in_rate > 0.0) || !(out_rate > 0.0) || in_rate / out_rate >= 64.0 || (uint32_t)quality > RN_RESAMPLE_BEST) return NULL;
+    if(taps_scale == 0 || taps_scale > 16) return NULL;
+
+    resampler = calloc(1, sizeof(RN_Resampler));
+    if(resampler == NULL) return NULL;
+
+    resampler->kernels = RN_SelectKernels();
+    resampler->taps = presets[quality].taps * taps_scale;
+    resampler->phases = presets[quality].phases;
+    resampler->step = (uint64_t)llround(in_rate / out_rate * 4294967296.0);
+    resampler->capacity = resampler->taps + 2 * RN_RESAMPLE_BLOCK;
+    resampler->bank = malloc((resampler->phases + 1) * resampler->taps * sizeof(float));
+    resampler->history[0] = malloc(resampler->capacity * sizeof(float));
+    resampler->history[1] = malloc(resampler->capacity * sizeof(float));
+
+    if(resampler->bank == NULL || resampler->history[0] == NULL || resampler->history[1] == NULL)
+    {
+        RN_ResamplerDestroy(resampler);
+        return NULL;
+    }
+
+    RN_ResamplerBuildBank(resampler, presets[quality].cutoff * (out_rate < in_rate ? out_rate / in_rate : 1.0), presets[quality].beta);
+    RN_ResamplerReset(resampler);
+
+    return resampler;
+}
+
+RN_Resampler *RN_ResamplerCreate(double in_rate, double out_rate, RN_ResampleQuality quality)
+{
+    return RN_ResamplerCreateScaled(in_rate, out_rate, quality, 1);
+}
+
+void RN_ResamplerDestroy(RN_Resampler *resampler)
+{
+    if(resampler == NULL) return;
+
+    free(resampler->bank);
+    free(resampler->history[0]);
+    free(resampler->history[1]);
+    free(resampler);
+}
+
+void RN_ResamplerReset(RN_Resampler *resampler)
+{
+    /* Silence before the first input, which output 0 is centred on */
+    memset(resampler->history[0], 0, resampler->capacity * sizeof(float));
+    memset(resampler->history[1], 0, resampler->capacity * sizeof(float));
+    resampler->fill = resampler->taps / 2 - 1;
+    resampler->position = 0;
+}
+
+/* Outputs whose taps are all in the history */
+static uint32_t RN_ResamplerAvailable(const RN_Resampler *resampler)
+{
+    uint64_t last;
+
+    if(resampler->fill < resampler->taps) return 0;
+
+    last = ((uint64_t)(resampler->fill - resampler->taps) << 32) | 0xffffffff;
+    return resampler->position > last ? 0 : (uint32_t)((last - resampler->position) / resampler->step) + 1;
+}
+
+uint32_t RN_ResamplerInputNeeded(RN_Resampler *resampler, uint32_t out_count)
+{
+    uint64_t required;
+
+    if(out_count == 0) return 0;
+
+    required = ((resampler->position + (out_count - 1) * resampler->step) >> 32) + resampler->taps;
+    return required > resampler->fill ? (uint32_t)(required - resampler->fill) : 0;
+}
+
+static void RN_ResamplerLoad(RN_Resampler *resampler, RN_SampleFormat format, const void *in, uint32_t count)
+{
+    float *left = resampler->history[0] + resampler->fill;
+    float *right = resampler->history[1] + resampler->fill;
+
+    switch(format & ~RN_FORMAT_PLANAR)
+    {
+        case RN_FORMAT_S32:
+            for(uint32_t i = 0; i < count; i++)
+            {
+                left[i] = (float)((const int32_t *)in)[i * 2];
+                right[i] = (float)((const int32_t *)in)[i * 2 + 1];
+            }
+            break;
+        case RN_FORMAT_F32:
+            for(uint32_t i = 0; i < count; i++)
+            {
+                left[i] = ((const float *)in)[i * 2] * 32768.0f;
+                right[i] = ((const float *)in)[i * 2 + 1] * 32768.0f;
+            }
+            break;
+        default:
+            for(uint32_t i = 0; i < count; i++)
+            {
+                left[i] = (float)((const int16_t *)in)[i * 2];
+                right[i] = (float)((const int16_t *)in)[i * 2 + 1];
+            }
+            break;
+    }
+
+    resampler->fill += count;
+}
+
+static void RN_ResamplerStore(RN_SampleFormat format, const float *samples, void *out, uint32_t count)
+{
+    switch(format & ~RN_FORMAT_PLANAR)
+    {
+        case RN_FORMAT_S32:
+            for(uint32_t i = 0; i < count * 2; i++) ((int32_t *)out)[i] = (int32_t)lrintf(samples[i]);
+            break;
+        case RN_FORMAT_F32:
+            for(uint32_t i = 0; i < count * 2; i++) ((float *)out)[i] = samples[i] * (1.0f / 32768.0f);
+            break;
+        default:
+            for(uint32_t i = 0; i < count * 2; i++)
+            {
+                float sample = samples[i] < -32768.0f ? -32768.0f : samples[i] > 32767.0f ? 32767.0f : samples[i];
+                ((int16_t *)out)[i] = (int16_t)lrintf(sample);
+            }
+            break;
+    }
+}
+
+/* Sizes of an interleaved stereo sample, int32 and float are the same */
+static size_t RN_ResamplerSampleSize(RN_SampleFormat format)
+{
+    return (format & ~RN_FORMAT_PLANAR) == RN_FORMAT_S16 ? 2 * sizeof(int16_t) : 2 * sizeof(float);
+}
+
+void RN_ResamplerRun(RN_Resampler *resampler, RN_SampleFormat in_format, const void *in, uint32_t *in_count,
+    RN_SampleFormat out_format, void *out, uint32_t *out_count)
+{
+    size_t in_size = RN_ResamplerSampleSize(in_format);
+    size_t out_size = RN_ResamplerSampleSize(out_format);
+    float block[RN_RESAMPLE_BLOCK * 2];
+    uint32_t consumed = 0;
+    uint32_t produced = 0;
+
+    for(;;)
+    {
+        uint32_t take = *in_count - consumed;
+        uint32_t count = RN_ResamplerAvailable(resampler);
+        uint32_t drop;
+
+        if(take > resampler->capacity - resampler->fill) take = resampler->capacity - resampler->fill;
+        if(take > 0)
+        {
+            RN_ResamplerLoad(resampler, in_format, (const uint8_t *)in + consumed * in_size, take);
+            consumed += take;
+            count = RN_ResamplerAvailable(resampler);
+        }
+
+        if(count > *out_count - produced) count = *out_count - produced;
+        if(count > RN_RESAMPLE_BLOCK) count = RN_RESAMPLE_BLOCK;
+        if(count > 0)
+        {
+            resampler->kernels->resample(resampler, block, count);
+            resampler->position += count * resampler->step;
+            RN_ResamplerStore(out_format, block, (uint8_t *)out + produced * out_size, count);
+            produced += count;
+        }
+
+        /* Input before the next output's first tap is no longer needed */
+        drop = (uint32_t)(resampler->position >> 32);
+        if(drop > resampler->fill) drop = resampler->fill;
+        if(drop > 0)
+        {
+            memmove(resampler->history[0], resampler->history[0] + drop, (resampler->fill - drop) * sizeof(float));
+            memmove(resampler->history[1], resampler->history[1] + drop, (resampler->fill - drop) * sizeof(float));
+            resampler->fill -= drop;
+            resampler->position -= (uint64_t)drop << 32;
+        }
+
+        if(take == 0 && count == 0) break;
+    }
+
+    *in_count = consumed;
+    *out_count = produced;
+}
+
+void RN_ResamplerProcess(RN_Resampler *resampler, RN_SampleFormat format, const void *in, uint32_t *in_count, void *out, uint32_t *out_count)
+{
+    RN_ResamplerRun(resampler, format, in, in_count, format, out, out_count);
+}
+
+void RN_RenderResampled(RN_Chip *chip, RN_Resampler *resampler, RN_SampleFormat format, void *buffer, uint32_t sample_count)
+{
+    size_t sample_size = RN_ResamplerSampleSize(format);
+    uint32_t block_limit = chip->sample_queue_length / 2 < RN_RESAMPLE_BLOCK ? chip->sample_queue_length / 2 : RN_RESAMPLE_BLOCK;
+    int32_t in[RN_RESAMPLE_BLOCK * 2];
+    uint32_t done = 0;
+
+    while(done < sample_count)
+    {
+        uint32_t needed = RN_ResamplerInputNeeded(resampler, sample_count - done);
+        uint32_t queued = RN_GetQueuedSamplesCount(chip);
+        uint32_t in_count;
+        uint32_t out_count = sample_count - done;
+
+        if(needed > block_limit) needed = block_limit;
+        if(queued < needed) RN_Clock(chip, (int)(needed - queued) * 24);
+
+        /* Unclamped input, the output format only applies to what comes out of the filter */
+        in_count = RN_DequeueSamplesFormat(chip, RN_FORMAT_S32, in, NULL, needed);
+        RN_ResamplerRun(resampler, RN_FORMAT_S32, in, &in_count, format, (uint8_t *)buffer + done * sample_size, &out_count);
+        done += out_count;
+    }
+}
@@ -0,0 +1,235 @@
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "renuke.h"
+#include "emu76489.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define CLAMP(x, low, high) (((x) < (low)) ? (low) : (((x) > (high)) ? (high) : (x)))
+
+/* Frames held by the chip sample queue */
+#define RN_SYSTEM_QUEUE_FRAMES (RN_SAMPLE_QUEUE_LENGTH / 2)
+/* Largest number of frames produced per chunk in RN_SystemClock */
+#define RN_SYSTEM_CHUNK_FRAMES 256
+/* PSG output is scaled by 1 << RN_SYSTEM_PSG_SHIFT (x4) before mixing */
+#define RN_SYSTEM_PSG_SHIFT 2
+
+struct RN_System
+{
+    RN_Chip *ym;
+    SNG *psg;
+    RN_Region region;
+
+    /* PSG frames rendered alongside the YM2612 sample queue, mixed on dequeue */
+    int32_t *psg_queue;
+    uint32_t psg_enqueue_position;
+    uint32_t psg_dequeue_position;
+};
+
+static uint32_t RN_SystemMasterClock(RN_Region region)
+{
+    return region == RN_REGION_PAL ? RN_MASTER_CLOCK_PAL : RN_MASTER_CLOCK_NTSC;
+}
+
+RN_System *RN_SystemCreate(RN_ChipType chip_type, RN_Region region, uint32_t psg_clock)
+{
+    uint32_t master_clock = RN_SystemMasterClock(region);
+    RN_System *system = calloc(1, sizeof(RN_System));
+    assert(system);
+    if(system == NULL) goto error;
+
+    system->region = region;
+
+    system->ym = RN_Create(chip_type);
+    if(system->ym == NULL) goto error;
+
+    /* PSG runs at master / 15 unless the caller knows better (VGM headers store the exact clock),
+       it is sampled once per YM2612 output sample (master / 7 / 144) */
+    if(psg_clock == 0) psg_clock = master_clock / 15;
+    system->psg = SNG_new(psg_clock, master_clock / (7 * 144));
+    assert(system->psg);
+    if(system->psg == NULL) goto error;
+
+    system->psg_queue = calloc(RN_SYSTEM_QUEUE_FRAMES, sizeof(int32_t) * 2);
+    assert(system->psg_queue);
+    if(system->psg_queue == NULL) goto error;
+
+    RN_SystemReset(system);
+
+    return system;
+
+    error:
+    RN_SystemDestroy(system);
+    return NULL;
+}
+
+void RN_SystemDestroy(RN_System *system)
+{
+    if(system == NULL) return;
+    if(system->ym != NULL) RN_Destroy(system->ym);
+    if(system->psg != NULL) SNG_delete(system->psg);
+    if(system->psg_queue != NULL) free(system->psg_queue);
+
+    free(system);
+}
+
+void RN_SystemReset(RN_System *system)
+{
+    /* RN_Reset also empties the sample queue, restart the PSG queue aligned with it */
+    RN_Reset(system->ym);
+    SNG_reset(system->psg);
+
+    system->psg_enqueue_position = 0;
+    system->psg_dequeue_position = 0;
+}
+
+RN_Chip *RN_SystemGetChip(RN_System *system)
+{
+    return system->ym;
+}
+
+uint32_t RN_SystemGetMasterClock(RN_System *system)
+{
+    return RN_SystemMasterClock(system->region);
+}
+
+void RN_SystemWriteYM(RN_System *system, uint32_t port, uint8_t data)
+{
+    RN_ScheduleWrite(system->ym, port, data);
+}
+
+void RN_SystemWritePSG(RN_System *system, uint8_t data)
+{
+    SNG_writeIO(system->psg, data);
+}
+
+void RN_SystemWritePSGStereo(RN_System *system, uint8_t data)
+{
+    SNG_writeGGIO(system->psg, data);
+}
+
+static void RN_SystemRenderPSG(RN_System *system, uint32_t frames)
+{
+    while(frames > 0)
+    {
+        uint32_t start = system->psg_enqueue_position % RN_SYSTEM_QUEUE_FRAMES;
+        uint32_t count = RN_SYSTEM_QUEUE_FRAMES - start;
+        if(count > frames) count = frames;
+
+        SNG_calc_block(system->psg, system->psg_queue + start * 2, count);
+
+        system->psg_enqueue_position += count;
+        frames -= count;
+    }
+}
+
+void RN_SystemClock(RN_System *system, int clock_count)
+{
+    /* The PSG renders exactly the frames the YM2612 completed, so writes to either chip
+       land on the same sample of the shared timeline regardless of how the calls are split */
+    while(clock_count > 0)
+    {
+        int clocks = clock_count < RN_SYSTEM_CHUNK_FRAMES * 24 ? clock_count : RN_SYSTEM_CHUNK_FRAMES * 24;
+        uint32_t queued = RN_GetQueuedSamplesCount(system->ym);
+
+        RN_Clock(system->ym, clocks);
+        RN_SystemRenderPSG(system, RN_GetQueuedSamplesCount(system->ym) - queued);
+
+        clock_count -= clocks;
+    }
+}
+
+uint32_t RN_SystemGetQueuedSamplesCount(RN_System *system)
+{
+    return RN_GetQueuedSamplesCount(system->ym);
+}
+
+/* out = clamp(acc_in + ym + (psg << RN_SYSTEM_PSG_SHIFT)) over interleaved values. The unclamped sum is
+   stored to acc_out instead when given, acc_in is NULL for the first (or only) system of a mix. */
+static void RN_SystemMix(int16_t *out, const int32_t *acc_in, int32_t *acc_out, const int16_t *ym, const int32_t *psg, uint32_t count)
+{
+    uint32_t i = 0;
+#if defined(__SSE2__)
+    for(; i + 8 <= count; i += 8)
+    {
+        __m128i y = _mm_loadu_si128((const __m128i *)(ym + i));
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(y, y), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(y, y), 16);
+        lo = _mm_add_epi32(lo, _mm_slli_epi32(_mm_loadu_si128((const __m128i *)(psg + i)), RN_SYSTEM_PSG_SHIFT));
+        hi = _mm_add_epi32(hi, _mm_slli_epi32(_mm_loadu_si128((const __m128i *)(psg + i + 4)), RN_SYSTEM_PSG_SHIFT));
+        if(acc_in != NULL)
+        {
+            lo = _mm_add_epi32(lo, _mm_loadu_si128((const __m128i *)(acc_in + i)));
+            hi = _mm_add_epi32(hi, _mm_loadu_si128((const __m128i *)(acc_in + i + 4)));
+        }
+        if(acc_out != NULL)
+        {
+            _mm_storeu_si128((__m128i *)(acc_out + i), lo);
+            _mm_storeu_si128((__m128i *)(acc_out + i + 4), hi);
+        }
+        else
+        {
+            /* Saturating pack is the clamp */
+            _mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi32(lo, hi));
+        }
+    }
+#endif
+    for(; i < count; i++)
+    {
+        int32_t mixed = ym[i] + psg[i] * (1 << RN_SYSTEM_PSG_SHIFT);
+        if(acc_in != NULL) mixed += acc_in[i];
+        if(acc_out != NULL) acc_out[i] = mixed;
+        else out[i] = CLAMP(mixed, -32768, 32767);
+    }
+}
+
+uint32_t RN_SystemDequeueSamples(RN_System *system, int16_t *buffer, uint32_t sample_count)
+{
+    return RN_SystemDequeueMixed(&system, 1, buffer, sample_count);
+}
+
+uint32_t RN_SystemDequeueMixed(RN_System *const *systems, uint32_t system_count, int16_t *buffer, uint32_t sample_count)
+{
+    int16_t ym[RN_SYSTEM_CHUNK_FRAMES * 2];
+    int32_t acc[RN_SYSTEM_CHUNK_FRAMES * 2];
+    uint32_t dequeued = 0;
+    uint32_t i;
+
+    if(system_count == 0) return 0;
+
+    while(dequeued < sample_count)
+    {
+        /* Largest run every system can provide without wrapping its PSG queue */
+        uint32_t count = sample_count - dequeued;
+        if(count > RN_SYSTEM_CHUNK_FRAMES) count = RN_SYSTEM_CHUNK_FRAMES;
+        for(i = 0; i < system_count; i++)
+        {
+            uint32_t start = systems[i]->psg_dequeue_position % RN_SYSTEM_QUEUE_FRAMES;
+            uint32_t queued = RN_GetQueuedSamplesCount(systems[i]->ym);
+            if(count > RN_SYSTEM_QUEUE_FRAMES - start) count = RN_SYSTEM_QUEUE_FRAMES - start;
+            if(count > queued) count = queued;
+        }
+        if(count == 0) break;
+
+        /* Sum all systems in 32 bits, the last one is fused with the clamp */
+        for(i = 0; i < system_count; i++)
+        {
+            RN_System *system = systems[i];
+            uint32_t start = system->psg_dequeue_position % RN_SYSTEM_QUEUE_FRAMES;
+            bool last = i == system_count - 1;
+
+            RN_DequeueSamples(system->ym, ym, count);
+            RN_SystemMix(buffer + dequeued * 2, i > 0 ? acc : NULL, last ? NULL : acc, ym, system->psg_queue + start * 2, count * 2);
+
+            system->psg_dequeue_position += count;
+        }
+
+        dequeued += count;
+    }
+
+    return dequeued;
+}
@@ -0,0 +1,155 @@
+#include <stdlib.h>
+#include <string.h>
+#include "renuke.h"
+#include "renuke_internal.h"
+
+/* Visualizer taps. RN_Clock runs the stem clock path while taps are on, in runs that end on the frames that
+   are tapped, so each tap holds that frame's stems and the envelopes as they were right after it.
+
+   The ring has one writer, the thread clocking the chip, and any number of readers. The writer announces
+   the frame it is about to overwrite in writing, fills it in and then publishes position. A reader copies
+   what position lets it and afterwards checks writing: a frame the writer had started on by then may be
+   torn and is dropped. */
+
+#if defined(__GNUC__) || defined(__clang__)
+#define RN_LOAD_ACQUIRE(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define RN_STORE_RELEASE(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define RN_STORE_RELAXED(p, v) __atomic_store_n(p, v, __ATOMIC_RELAXED)
+#define RN_FENCE_ACQUIRE() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define RN_FENCE_RELEASE() __atomic_thread_fence(__ATOMIC_RELEASE)
+#elif defined(_MSC_VER)
+#include <intrin.h>
+/* Aligned 32 bit volatile accesses are atomic, x86 and x64 only need the compiler kept from reordering them */
+#if defined(_M_ARM64)
+#define RN_FENCE() __dmb(_ARM64_BARRIER_ISH)
+#else
+#define RN_FENCE() _ReadWriteBarrier()
+#endif
+#define RN_LOAD_ACQUIRE(p) RN_LoadAcquire(p)
+#define RN_STORE_RELEASE(p, v) do { RN_FENCE(); *(volatile uint32_t *)(p) = (v); } while (0)
+#define RN_STORE_RELAXED(p, v) (*(volatile uint32_t *)(p) = (v))
+#define RN_FENCE_ACQUIRE() RN_FENCE()
+#define RN_FENCE_RELEASE() RN_FENCE()
+static uint32_t RN_LoadAcquire(const uint32_t *p)
+{
+    uint32_t value = *(const volatile uint32_t *)p;
+    RN_FENCE();
+    return value;
+}
+#else
+#error "No atomics for the taps ring on this compiler"
+#endif
+
+struct RN_Taps
+{
+    RN_TapFrame frames[RN_TAP_FRAMES];
+    uint32_t decimation;
+    uint32_t countdown; /* Frames until the next tap */
+    uint32_t writing;   /* One past the frame being written */
+    uint32_t position;  /* Frames finished */
+};
+
+RN_Taps *RN_TapsBegin(RN_Chip *chip, uint32_t decimation)
+{
+    RN_Taps *taps;
+
+    if(chip->taps != NULL) RN_TapsEnd(chip);
+    if(decimation == 0) return NULL;
+
+    taps = calloc(1, sizeof(RN_Taps));
+    if(taps == NULL) return NULL;
+
+    taps->decimation = decimation;
+    taps->countdown = decimation;
+    chip->taps = taps;
+    return taps;
+}
+
+void RN_TapsEnd(RN_Chip *chip)
+{
+    free(chip->taps);
+    chip->taps = NULL;
+}
+
+uint32_t RN_TapsPosition(RN_Taps *taps)
+{
+    return RN_LOAD_ACQUIRE(&taps->position);
+}
+
+static int16_t RN_TapLevel(int32_t left, int32_t right)
+{
+    int32_t level = (left + right) * (RN_GAIN / 2);
+    return (int16_t)(level < -32768 ? -32768 : level > 32767 ? 32767 : level);
+}
+
+static void RN_TapsPush(RN_Chip *chip, RN_Taps *taps, const RN_StemFrames frames, uint32_t frame)
+{
+    uint32_t index = taps->position;
+    RN_TapFrame *tap = &taps->frames[index % RN_TAP_FRAMES];
+
+    RN_STORE_RELAXED(&taps->writing, index + 1);
+    RN_FENCE_RELEASE();
+
+    for(uint32_t stem = 0; stem < RN_STEM_COUNT; stem++)
+    {
+        tap->channels[stem] = RN_TapLevel(frames[stem][frame * 2], frames[stem][frame * 2 + 1]);
+    }
+    memcpy(tap->eg_out, chip->eg_out, sizeof(tap->eg_out));
+
+    RN_STORE_RELEASE(&taps->position, index + 1);
+}
+
+void RN_TapsClock(RN_Chip *chip, int clock_count)
+{
+    RN_Taps *taps = chip->taps;
+    RN_StemFrames frames;
+
+    /* As in RN_ClockStems, sums left over from RN_ClockStems before RN_Clock finished their frame are stale */
+    if(chip->stem_position != chip->sample_enqueue_position) memset(chip->stem_sample, 0, sizeof(chip->stem_sample));
+
+    while(clock_count > 0)
+    {
+        uint32_t chunk = taps->countdown < RN_STEM_CHUNK ? taps->countdown : RN_STEM_CHUNK;
+        int run = (int)chunk * 24 - (int)chip->cycles;
+        if(run > clock_count) run = clock_count;
+
+        uint32_t count = chip->kernels->clock_stems(chip, run, frames);
+        taps->countdown -= count;
+        if(taps->countdown == 0)
+        {
+            RN_TapsPush(chip, taps, frames, count - 1);
+            taps->countdown = taps->decimation;
+        }
+
+        clock_count -= run;
+    }
+
+    chip->stem_position = chip->sample_enqueue_position;
+}
+
+uint32_t RN_TapsRead(RN_Taps *taps, uint32_t *cursor, RN_TapFrame *frames, uint32_t frame_count)
+{
+    uint32_t end = RN_LOAD_ACQUIRE(&taps->position);
+    uint32_t start = *cursor;
+    uint32_t count, valid;
+
+    /* The oldest frame the writer can not be overwriting yet, also where a cursor from elsewhere lands */
+    if(end - start > RN_TAP_FRAMES - 1) start = end - (RN_TAP_FRAMES - 1);
+
+    count = end - start < frame_count ? end - start : frame_count;
+    for(uint32_t i = 0; i < count; i++) frames[i] = taps->frames[(start + i) % RN_TAP_FRAMES];
+
+    /* Frames from writing - RN_TAP_FRAMES on were not touched while copying */
+    RN_FENCE_ACQUIRE();
+    valid = RN_LOAD_ACQUIRE(&taps->writing) - RN_TAP_FRAMES;
+    if((int32_t)(valid - start) > 0)
+    {
+        uint32_t torn = valid - start < count ? valid - start : count;
+        memmove(frames, frames + torn, (count - torn) * sizeof(RN_TapFrame));
+        count -= torn;
+        start += torn;
+    }
+
+    *cursor = start + count;
+    return count;
+}
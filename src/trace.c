@@ -0,0 +1,470 @@
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L /* ftruncate */
+#endif
+
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "renuke.h"
+#include "renuke_internal.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define RN_TRACE_HAVE_MMAP
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+/* File layout (little endian):
+     "RNTRACE2", chip type (u32), state size (u32), chip state up to chip_type,
+     sample accumulators (2 x i32), next_write_clocks (i32), next_note_clocks (i32), note_deferred (u8),
+     queued sample count (u32) and raw samples, pending scheduled write count (u32) and writes (u16 port, u8 data),
+   followed by records. The high nibble of a record byte is its type, the low bits its port or value.
+   Consecutive clock calls of one kind are merged into a single record, so they double as cycle timestamps.
+   Record types are listed in renuke_internal.h. */
+#define RN_TRACE_MAGIC "RNTRACE2"
+
+#define RN_TRACE_BUFFER_SIZE (64 * 1024)
+#define RN_TRACE_MAP_SIZE (1024 * 1024)
+
+struct RN_Trace
+{
+    /* Clock calls not written yet, flushed by the next record of another kind */
+    uint8_t pending_type;
+    uint32_t pending_count;
+
+    int error;
+
+    /* Buffered sink */
+    FILE *file;
+    uint8_t *buffer;
+    size_t used;
+    size_t size;
+
+#ifdef RN_TRACE_HAVE_MMAP
+    /* mmap'd sink, buffer points into the mapping */
+    int fd;
+    size_t offset;
+#endif
+};
+
+static void RN_TraceSinkFlush(RN_Trace *trace, size_t needed)
+{
+#ifdef RN_TRACE_HAVE_MMAP
+    if(trace->fd >= 0)
+    {
+        /* Grow the file and map the next window */
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        size_t committed = trace->offset + (trace->used / page) * page;
+        size_t size = needed > RN_TRACE_MAP_SIZE ? needed + page : RN_TRACE_MAP_SIZE;
+
+        if(trace->buffer != NULL) munmap(trace->buffer, trace->size);
+        trace->buffer = NULL;
+
+        if(ftruncate(trace->fd, (off_t)(committed + size)) != 0) goto error;
+
+        void *mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, trace->fd, (off_t)committed);
+        if(mapping == MAP_FAILED) goto error;
+
+        trace->used -= committed - trace->offset;
+        trace->offset = committed;
+        trace->buffer = mapping;
+        trace->size = size;
+        return;
+    }
+#endif
+
+    if(fwrite(trace->buffer, 1, trace->used, trace->file) != trace->used) goto error;
+    trace->used = 0;
+    if(needed > trace->size) goto error;
+    return;
+
+    error:
+    trace->error = 1;
+}
+
+static inline void RN_TraceBytes(RN_Trace *trace, const void *data, size_t size)
+{
+    if(trace->used + size > trace->size)
+    {
+        RN_TraceSinkFlush(trace, size);
+        if(trace->error) return;
+    }
+
+    memcpy(trace->buffer + trace->used, data, size);
+    trace->used += size;
+}
+
+static void RN_TraceU32(RN_Trace *trace, uint32_t value)
+{
+    uint8_t bytes[4] = { value & 0xff, (value >> 8) & 0xff, (value >> 16) & 0xff, value >> 24 };
+    RN_TraceBytes(trace, bytes, 4);
+}
+
+static void RN_TraceVarint(RN_Trace *trace, uint8_t type, uint32_t value)
+{
+    uint8_t bytes[6];
+    size_t size = 0;
+
+    bytes[size++] = type;
+    do
+    {
+        bytes[size++] = (value & 0x7f) | (value > 0x7f ? 0x80 : 0);
+        value >>= 7;
+    } while(value);
+
+    RN_TraceBytes(trace, bytes, size);
+}
+
+static inline void RN_TraceFlushClock(RN_Trace *trace)
+{
+    if(trace->pending_count == 0) return;
+
+    RN_TraceVarint(trace, trace->pending_type, trace->pending_count);
+    trace->pending_count = 0;
+}
+
+void RN_TraceRecord(RN_Trace *trace, uint8_t type, uint32_t port, uint8_t data)
+{
+    uint8_t bytes[2] = { type | (port & 3), data };
+
+    RN_TraceFlushClock(trace);
+    RN_TraceBytes(trace, bytes, type == RN_TRACE_TEST_PIN || type == RN_TRACE_RESET ? 1 : 2);
+}
+
+void RN_TraceClock(RN_Trace *trace, uint8_t type, uint32_t count)
+{
+    if(trace->pending_type != type || trace->pending_count > 0xffffffffu - count)
+    {
+        RN_TraceFlushClock(trace);
+        trace->pending_type = type;
+    }
+
+    trace->pending_count += count;
+}
+
+void RN_TraceDequeue(RN_Trace *trace, uint32_t sample_count)
+{
+    RN_TraceFlushClock(trace);
+    RN_TraceVarint(trace, RN_TRACE_DEQUEUE, sample_count);
+}
+
+static void RN_TraceSnapshot(RN_Trace *trace, RN_Chip *chip)
+{
+    uint32_t i;
+    uint32_t queued = chip->sample_enqueue_position - chip->sample_dequeue_position;
+    uint32_t pending = chip->write_enqueue_position - chip->write_dequeue_position;
+
+    if(queued > chip->sample_queue_length / 2) queued = chip->sample_queue_length / 2;
+
+    RN_TraceBytes(trace, RN_TRACE_MAGIC, 8);
+    RN_TraceU32(trace, chip->chip_type);
+    RN_TraceU32(trace, (uint32_t)RN_CHIP_STATE_SIZE);
+    RN_TraceBytes(trace, chip, RN_CHIP_STATE_SIZE);
+
+    RN_TraceU32(trace, (uint32_t)chip->current_sample[0]);
+    RN_TraceU32(trace, (uint32_t)chip->current_sample[1]);
+    RN_TraceU32(trace, (uint32_t)chip->next_write_clocks);
+    RN_TraceU32(trace, (uint32_t)chip->next_note_clocks);
+    RN_TraceBytes(trace, &chip->note_deferred, 1);
+
+    RN_TraceU32(trace, queued);
+    for(i = 0; i < queued * 2; i++)
+    {
+        int16_t sample = chip->sample_queue[((chip->sample_dequeue_position * 2) + i) & (chip->sample_queue_length - 1)];
+        uint8_t bytes[2] = { (uint16_t)sample & 0xff, (uint16_t)sample >> 8 };
+        RN_TraceBytes(trace, bytes, 2);
+    }
+
+    RN_TraceU32(trace, pending);
+    for(i = 0; i < pending; i++)
+    {
+        const ScheduledWrite *write = chip->write_queue + ((chip->write_dequeue_position + i) & (chip->write_queue_length - 1));
+        uint8_t bytes[3] = { write->port & 0xff, write->port >> 8, write->data };
+        RN_TraceBytes(trace, bytes, 3);
+    }
+}
+
+int RN_TraceBegin(RN_Chip *chip, const char *path, uint32_t flags)
+{
+    RN_Trace *trace;
+
+    if(chip->trace != NULL) RN_TraceEnd(chip);
+
+    trace = calloc(1, sizeof(RN_Trace));
+    if(trace == NULL) return -1;
+
+#ifdef RN_TRACE_HAVE_MMAP
+    trace->fd = -1;
+    if(flags & RN_TRACE_MMAP)
+    {
+        trace->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if(trace->fd < 0) goto error;
+    }
+    else
+#endif
+    {
+        trace->file = fopen(path, "wb");
+        trace->buffer = malloc(RN_TRACE_BUFFER_SIZE);
+        trace->size = RN_TRACE_BUFFER_SIZE;
+        if(trace->file == NULL || trace->buffer == NULL) goto error;
+    }
+
+    RN_TraceSnapshot(trace, chip);
+    if(trace->error) goto error;
+
+    chip->trace = trace;
+    return 0;
+
+    error:
+#ifdef RN_TRACE_HAVE_MMAP
+    if(trace->fd >= 0)
+    {
+        if(trace->buffer != NULL) munmap(trace->buffer, trace->size);
+        close(trace->fd);
+        trace->buffer = NULL;
+    }
+#endif
+    if(trace->file != NULL) fclose(trace->file);
+    free(trace->buffer);
+    free(trace);
+    return -1;
+}
+
+int RN_TraceEnd(RN_Chip *chip)
+{
+    RN_Trace *trace = chip->trace;
+    int error;
+
+    if(trace == NULL) return 0;
+    chip->trace = NULL;
+
+    RN_TraceFlushClock(trace);
+
+#ifdef RN_TRACE_HAVE_MMAP
+    if(trace->fd >= 0)
+    {
+        if(trace->buffer != NULL) munmap(trace->buffer, trace->size);
+        if(ftruncate(trace->fd, (off_t)(trace->offset + trace->used)) != 0) trace->error = 1;
+        if(close(trace->fd) != 0) trace->error = 1;
+        error = trace->error;
+        free(trace);
+        return error ? -1 : 0;
+    }
+#endif
+
+    if(!trace->error) RN_TraceSinkFlush(trace, 0);
+    if(fclose(trace->file) != 0) trace->error = 1;
+    error = trace->error;
+
+    free(trace->buffer);
+    free(trace);
+    return error ? -1 : 0;
+}
+
+/* Replay */
+
+typedef struct
+{
+    const uint8_t *data;
+    size_t size;
+    size_t pos;
+    int error;
+} RN_TraceReader;
+
+static const uint8_t *RN_TraceRead(RN_TraceReader *reader, size_t size)
+{
+    if(reader->size - reader->pos < size)
+    {
+        reader->error = 1;
+        return NULL;
+    }
+
+    reader->pos += size;
+    return reader->data + reader->pos - size;
+}
+
+static uint32_t RN_TraceReadU32(RN_TraceReader *reader)
+{
+    const uint8_t *bytes = RN_TraceRead(reader, 4);
+    if(bytes == NULL) return 0;
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+static uint32_t RN_TraceReadVarint(RN_TraceReader *reader)
+{
+    uint32_t value = 0;
+    int shift;
+
+    for(shift = 0; shift < 35; shift += 7)
+    {
+        const uint8_t *byte = RN_TraceRead(reader, 1);
+        if(byte == NULL) return 0;
+
+        value |= (uint32_t)(*byte & 0x7f) << shift;
+        if(!(*byte & 0x80)) return value;
+    }
+
+    reader->error = 1;
+    return 0;
+}
+
+static RN_Chip *RN_TraceRestore(RN_TraceReader *reader)
+{
+    uint32_t i;
+    const uint8_t *magic = RN_TraceRead(reader, 8);
+    RN_ChipType chip_type = (RN_ChipType)RN_TraceReadU32(reader);
+    uint32_t state_size = RN_TraceReadU32(reader);
+
+    /* Only traces of the same state layout can be restored */
+    if(magic == NULL || memcmp(magic, RN_TRACE_MAGIC, 8) != 0 || state_size != RN_CHIP_STATE_SIZE) return NULL;
+
+    const uint8_t *state = RN_TraceRead(reader, state_size);
+    if(state == NULL) return NULL;
+
+    RN_Chip *chip = RN_Create(chip_type);
+    if(chip == NULL) return NULL;
+
+    memcpy(chip, state, state_size);
+    /* The snapshot stops at chip_type, rebuild the per-sample engine caches from the restored state */
+    chip->fast_inc_dirty = 0xffffff;
+    chip->fast_eg_idle = 0;
+    chip->current_sample[0] = (int32_t)RN_TraceReadU32(reader);
+    chip->current_sample[1] = (int32_t)RN_TraceReadU32(reader);
+    chip->next_write_clocks = (int)RN_TraceReadU32(reader);
+    chip->next_note_clocks = (int)RN_TraceReadU32(reader);
+
+    const uint8_t *note_deferred = RN_TraceRead(reader, 1);
+    if(note_deferred != NULL) chip->note_deferred = *note_deferred;
+
+    uint32_t queued = RN_TraceReadU32(reader);
+    if(queued > chip->sample_queue_length / 2) reader->error = 1;
+    for(i = 0; i < queued * 2 && !reader->error; i++)
+    {
+        const uint8_t *bytes = RN_TraceRead(reader, 2);
+        if(bytes != NULL) chip->sample_queue[i] = (int16_t)(bytes[0] | (bytes[1] << 8));
+    }
+    chip->sample_enqueue_position = queued;
+
+    uint32_t pending = RN_TraceReadU32(reader);
+    if(pending > chip->write_queue_length) reader->error = 1;
+    for(i = 0; i < pending && !reader->error; i++)
+    {
+        const uint8_t *bytes = RN_TraceRead(reader, 3);
+        if(bytes == NULL) break;
+        chip->write_queue[i].port = bytes[0] | (bytes[1] << 8);
+        chip->write_queue[i].data = bytes[2];
+    }
+    chip->write_enqueue_position = pending;
+
+    if(reader->error)
+    {
+        RN_Destroy(chip);
+        return NULL;
+    }
+
+    return chip;
+}
+
+int RN_TraceReplay(const char *path, RN_TraceSamples on_samples, void *userdata)
+{
+    RN_TraceReader reader = {0};
+    int16_t samples[RN_SAMPLE_QUEUE_LENGTH];
+    int16_t buffer[2];
+    int mismatches = 0;
+    uint8_t *data = NULL;
+    RN_Chip *chip = NULL;
+    long size;
+
+    FILE *file = fopen(path, "rb");
+    if(file == NULL) return -1;
+
+    if(fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) < 0 || fseek(file, 0, SEEK_SET) != 0) goto error;
+
+    data = malloc(size > 0 ? (size_t)size : 1);
+    if(data == NULL || fread(data, 1, (size_t)size, file) != (size_t)size) goto error;
+
+    reader.data = data;
+    reader.size = (size_t)size;
+
+    chip = RN_TraceRestore(&reader);
+    if(chip == NULL) goto error;
+
+    while(reader.pos < reader.size && !reader.error)
+    {
+        uint8_t record = *RN_TraceRead(&reader, 1);
+        uint32_t port = record & 3;
+        uint32_t count;
+        const uint8_t *byte;
+
+        switch(record & 0xf0)
+        {
+            case RN_TRACE_WRITE:
+                if((byte = RN_TraceRead(&reader, 1)) != NULL) RN_Write(chip, port, *byte);
+                break;
+            case RN_TRACE_SCHEDULE:
+                if((byte = RN_TraceRead(&reader, 1)) != NULL) RN_ScheduleWrite(chip, port, *byte);
+                break;
+            case RN_TRACE_READ:
+                if((byte = RN_TraceRead(&reader, 1)) != NULL && RN_Read(chip, port) != *byte) mismatches++;
+                break;
+            case RN_TRACE_TEST_PIN:
+                RN_SetTestPin(chip, record & 1);
+                break;
+            case RN_TRACE_CLOCK:
+                count = RN_TraceReadVarint(&reader);
+                while(count > 0 && !reader.error)
+                {
+                    int clocks = count > 0x10000 ? 0x10000 : (int)count;
+                    RN_Clock(chip, clocks);
+                    count -= clocks;
+                }
+                break;
+            case RN_TRACE_CLOCK_CYCLES:
+                /* The per-cycle output went to the caller's filter, samples is only scratch space here */
+                count = RN_TraceReadVarint(&reader);
+                while(count > 0 && !reader.error)
+                {
+                    int clocks = count > RN_SAMPLE_QUEUE_LENGTH / 2 ? RN_SAMPLE_QUEUE_LENGTH / 2 : (int)count;
+                    RN_ClockCycles(chip, clocks, samples);
+                    count -= clocks;
+                }
+                break;
+            case RN_TRACE_CLOCK1:
+                count = RN_TraceReadVarint(&reader);
+                while(count-- > 0 && !reader.error) RN_Clock1(chip, buffer);
+                break;
+            case RN_TRACE_DEQUEUE:
+                count = RN_TraceReadVarint(&reader);
+                while(count > 0 && !reader.error)
+                {
+                    uint32_t request = count > RN_SAMPLE_QUEUE_LENGTH / 2 ? RN_SAMPLE_QUEUE_LENGTH / 2 : count;
+                    uint32_t dequeued = RN_DequeueSamples(chip, samples, request);
+                    if(on_samples != NULL && dequeued > 0) on_samples(userdata, samples, dequeued);
+                    if(dequeued < request) break;
+                    count -= dequeued;
+                }
+                break;
+            case RN_TRACE_RESET:
+                RN_Reset(chip);
+                break;
+            default:
+                reader.error = 1;
+                break;
+        }
+    }
+
+    if(reader.error) goto error;
+
+    RN_Destroy(chip);
+    free(data);
+    fclose(file);
+    return mismatches;
+
+    error:
+    if(chip != NULL) RN_Destroy(chip);
+    free(data);
+    fclose(file);
+    return -1;
+}
@@ -0,0 +1,598 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "renuke.h"
+
+// Golden output regression harness. Replays a register script on every chip type and hashes
+// the per-cycle mol/mor output (RN_Clock1) and the per-sample queue output (RN_Clock) in windows
+// of WINDOW_CYCLES, comparing them against committed golden hashes. Every window also keeps a 4 bit
+// leaf hash per sample (sample stream) or per 24 cycle slice (cycle stream), so a failure is narrowed
+// down to the first divergent sample or slice without a known good build at hand. The sample queue is
+// dequeued in a different output format every window and converted back to int16, so all formats hash alike.
+// Blocks of 6 windows take turns between the clock paths: plain RN_Clock, RN_Clock with taps on, one frame
+// per sample, whose channels have to add up to the mix, and RN_ClockStems, whose stems have to as well.
+// The fast engine (RNCM_FAST) has golden hashes of its own, for the sample queue only.
+//
+// Usage:
+//   renuke-golden <script> <golden>             Compare, reports the first divergent sample or slice
+//   renuke-golden --generate <script> <golden>  (Re)write the golden file
+//   renuke-golden --trace <chip> <first> <last> <script>
+//                                               Print per-cycle output, to diff two builds
+//
+// Script commands, one per line, numbers in C notation, '#' starts a comment:
+//   mode read             Adds RNCM_READ_MODE to the chip type (must come first)
+//   w <part> <reg> <data> Address write, 12 clocks, data write, 36 clocks
+//   p <port> <data>       Raw port write without clocking
+//   c <cycles>            Clock
+//   r <port>              Read (status, test data), the value is hashed
+//   t <value>             Set the TEST pin
+//   i                     Hash the IRQ and TEST pins
+
+#define WINDOW_CYCLES 4096
+#define ADDRESS_CLOCKS 12
+#define DATA_CLOCKS 36
+#define SLICE_CYCLES 24
+#define MAX_LEAVES ((WINDOW_CYCLES + SLICE_CYCLES - 1) / SLICE_CYCLES)
+#define MAX_LINE (MAX_LEAVES + 256)
+
+typedef enum
+{
+    STREAM_CYCLE,   // RN_Clock1 mol/mor, every cycle
+    STREAM_SAMPLE,  // RN_Clock sample queue, every 24 cycles
+    STREAM_COUNT
+} Stream;
+
+static const char *stream_names[STREAM_COUNT] = { "cycle", "sample" };
+
+// The fast engine's RN_Clock1 only holds frame averages, so it is hashed on the sample stream alone
+static const struct
+{
+    const char *name;
+    RN_ChipType type;
+    uint32_t streams;
+} chip_types[] =
+{
+    { "ym2612", RNCM_YM2612, (1 << STREAM_CYCLE) | (1 << STREAM_SAMPLE) },
+    { "ym3438", 0, (1 << STREAM_CYCLE) | (1 << STREAM_SAMPLE) },
+    { "ym2612-fast", RNCM_YM2612 | RNCM_FAST, 1 << STREAM_SAMPLE },
+    { "ym3438-fast", RNCM_FAST, 1 << STREAM_SAMPLE },
+};
+
+#define CHIP_TYPE_COUNT (sizeof(chip_types) / sizeof(chip_types[0]))
+
+typedef struct
+{
+    char op;
+    uint32_t args[3];
+    int line;
+} Command;
+
+typedef struct
+{
+    Command *commands;
+    size_t count;
+    RN_ChipType mode;
+} Script;
+
+typedef struct
+{
+    uint64_t hash;
+    uint64_t first_sample;          // Samples hashed before the window (sample stream)
+    char leaves[MAX_LEAVES + 1];    // One hex digit per sample or slice
+} Window;
+
+typedef struct
+{
+    Window *windows;
+    size_t count;
+    size_t capacity;
+} Windows;
+
+typedef struct
+{
+    RN_Chip *chip;
+    Stream stream;
+    uint64_t cycle;
+    uint64_t hash;
+    Windows windows;
+    RN_Taps *taps;
+    uint32_t tap_cursor;
+
+    // Leaf hash of the current sample or slice, values hashed between leaves go to the next one
+    uint64_t leaf_hash;
+    char leaves[MAX_LEAVES + 1];
+    size_t leaf_count;
+    uint64_t samples;
+    uint64_t first_sample;
+
+    // Trace mode prints cycles [trace_first, trace_last] instead of hashing
+    int trace;
+    uint64_t trace_first;
+    uint64_t trace_last;
+} Run;
+
+static void fail(const char *message, const char *detail)
+{
+    fprintf(stderr, "%s%s\n", message, detail ? detail : "");
+    exit(1);
+}
+
+static void *grow(void *data, size_t *capacity, size_t count, size_t size)
+{
+    if (count < *capacity) return data;
+
+    *capacity = *capacity ? *capacity * 2 : 64;
+    data = realloc(data, *capacity * size);
+    if (!data) fail("Out of memory", NULL);
+    return data;
+}
+
+static Script load_script(const char *filename)
+{
+    Script script = {0};
+    size_t capacity = 0;
+    char line[MAX_LINE];
+    int line_number = 0;
+
+    FILE *f = fopen(filename, "r");
+    if (!f) fail("Failed to open script: ", filename);
+
+    while (fgets(line, sizeof(line), f))
+    {
+        Command command = {0};
+        char op[8];
+        long args[3] = {0};
+        char *comment = strchr(line, '#');
+
+        line_number++;
+        if (comment) *comment = '\0';
+
+        int fields = sscanf(line, "%7s %li %li %li", op, &args[0], &args[1], &args[2]);
+        if (fields <= 0) continue;
+
+        if (strcmp(op, "mode") == 0)
+        {
+            if (script.count > 0 || !strstr(line, "read")) fail("Invalid mode line in ", filename);
+            script.mode |= RNCM_READ_MODE;
+            continue;
+        }
+
+        static const struct { char op; int args; } syntax[] =
+        {
+            { 'w', 3 }, { 'p', 2 }, { 'c', 1 }, { 'r', 1 }, { 't', 1 }, { 'i', 0 }
+        };
+
+        size_t s;
+        for (s = 0; s < sizeof(syntax) / sizeof(syntax[0]); s++)
+        {
+            if (op[0] == syntax[s].op && op[1] == '\0' && fields - 1 == syntax[s].args) break;
+        }
+
+        if (s == sizeof(syntax) / sizeof(syntax[0]))
+        {
+            fprintf(stderr, "%s:%d: ", filename, line_number);
+            fail("Invalid command", NULL);
+        }
+
+        command.op = op[0];
+        command.line = line_number;
+        for (int a = 0; a < 3; a++) command.args[a] = (uint32_t)args[a];
+
+        script.commands = grow(script.commands, &capacity, script.count, sizeof(Command));
+        script.commands[script.count++] = command;
+    }
+
+    fclose(f);
+    return script;
+}
+
+// FNV-1a, 64 bit
+static void hash_bytes(Run *run, const void *data, size_t size)
+{
+    const uint8_t *bytes = data;
+    for (size_t i = 0; i < size; i++)
+    {
+        run->hash = (run->hash ^ bytes[i]) * 0x100000001b3ULL;
+        run->leaf_hash = (run->leaf_hash ^ bytes[i]) * 0x100000001b3ULL;
+    }
+}
+
+static void hash_value(Run *run, char tag, uint32_t value)
+{
+    uint8_t bytes[5] = { (uint8_t)tag, value & 0xFF, (value >> 8) & 0xFF, (value >> 16) & 0xFF, (value >> 24) & 0xFF };
+    hash_bytes(run, bytes, sizeof(bytes));
+}
+
+static void end_leaf(Run *run)
+{
+    if (run->leaf_count == MAX_LEAVES) fail("Too many leaves in a window", NULL);
+    run->leaves[run->leaf_count++] = "0123456789abcdef"[run->leaf_hash >> 60];
+    run->leaf_hash = 0xcbf29ce484222325ULL;
+}
+
+static void end_window(Run *run)
+{
+    // Close the partial slice a trailing window ends with
+    if (run->stream == STREAM_CYCLE && run->cycle % WINDOW_CYCLES % SLICE_CYCLES != 0) end_leaf(run);
+
+    run->windows.windows = grow(run->windows.windows, &run->windows.capacity, run->windows.count, sizeof(Window));
+    Window *window = &run->windows.windows[run->windows.count++];
+    window->hash = run->hash;
+    window->first_sample = run->first_sample;
+    memcpy(window->leaves, run->leaves, run->leaf_count);
+    window->leaves[run->leaf_count] = '\0';
+
+    run->hash = 0xcbf29ce484222325ULL;
+    run->leaf_count = 0;
+    run->first_sample = run->samples;
+}
+
+static int16_t clamp_s16(int32_t value)
+{
+    return value < -32768 ? -32768 : value > 32767 ? 32767 : (int16_t)value;
+}
+
+// RN_DequeueSamplesFormat in the window's format, returned as interleaved int16
+static uint32_t dequeue_s16(Run *run, int16_t *buffer, uint32_t sample_count)
+{
+    static const RN_SampleFormat formats[] =
+    {
+        RN_FORMAT_S16, RN_FORMAT_S32, RN_FORMAT_F32,
+        RN_FORMAT_S16 | RN_FORMAT_PLANAR, RN_FORMAT_S32 | RN_FORMAT_PLANAR, RN_FORMAT_F32 | RN_FORMAT_PLANAR
+    };
+    static union { int16_t s16[RN_SAMPLE_QUEUE_LENGTH]; int32_t s32[RN_SAMPLE_QUEUE_LENGTH]; float f32[RN_SAMPLE_QUEUE_LENGTH]; } out;
+
+    RN_SampleFormat format = formats[run->cycle / WINDOW_CYCLES % (sizeof(formats) / sizeof(formats[0]))];
+    RN_SampleFormat type = format & ~RN_FORMAT_PLANAR;
+    int planar = (format & RN_FORMAT_PLANAR) != 0;
+    uint32_t half = RN_SAMPLE_QUEUE_LENGTH / 2;
+    void *right = NULL;
+
+    if (planar) right = type == RN_FORMAT_S16 ? (void *)(out.s16 + half) : (void *)(out.s32 + half);
+
+    if (sample_count > half) sample_count = half;
+    uint32_t count = RN_DequeueSamplesFormat(run->chip, format, &out, right, sample_count);
+
+    for (uint32_t i = 0; i < count * 2; i++)
+    {
+        // Channel i % 2 of sample i / 2
+        uint32_t index = planar ? (i % 2) * half + i / 2 : i;
+        switch (type)
+        {
+            case RN_FORMAT_S16: buffer[i] = out.s16[index]; break;
+            case RN_FORMAT_S32: buffer[i] = clamp_s16(out.s32[index]); break;
+            default: buffer[i] = clamp_s16((int32_t)(out.f32[index] * 32768.0f)); break;
+        }
+    }
+
+    return count;
+}
+
+// Every sample the last RN_Clock made has a tap frame, whose channels add up to the mix where nothing clipped
+static void check_taps(Run *run, const int16_t *buffer, uint32_t count)
+{
+    static RN_TapFrame frames[RN_SAMPLE_QUEUE_LENGTH / 2];
+
+    if (RN_TapsRead(run->taps, &run->tap_cursor, frames, count) != count) fail("Missing tap frames", NULL);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        int32_t sum = 0, clipped = 0;
+        for (int stem = 0; stem < RN_STEM_COUNT; stem++)
+        {
+            sum += frames[i].channels[stem];
+            clipped |= frames[i].channels[stem] == -32768 || frames[i].channels[stem] == 32767;
+        }
+        clipped |= buffer[i * 2] == -32768 || buffer[i * 2] == 32767 || buffer[i * 2 + 1] == -32768 || buffer[i * 2 + 1] == 32767;
+        if (!clipped && sum != (buffer[i * 2] + buffer[i * 2 + 1]) / 2) fail("Taps do not add up to the mix", NULL);
+    }
+}
+
+static void clock_cycles(Run *run, uint32_t cycles)
+{
+    int16_t buffer[RN_SAMPLE_QUEUE_LENGTH];
+
+    while (cycles > 0)
+    {
+        uint32_t step = WINDOW_CYCLES - run->cycle % WINDOW_CYCLES;
+        if (step > cycles) step = cycles;
+
+        if (run->stream == STREAM_CYCLE)
+        {
+            for (uint32_t i = 0; i < step; i++)
+            {
+                RN_Clock1(run->chip, buffer);
+
+                uint64_t cycle = run->cycle + i;
+                if (run->trace && cycle >= run->trace_first && cycle <= run->trace_last)
+                {
+                    printf("%llu %d %d\n", (unsigned long long)cycle, buffer[0], buffer[1]);
+                }
+
+                hash_value(run, 'o', (uint16_t)buffer[0] | ((uint32_t)(uint16_t)buffer[1] << 16));
+                if ((cycle + 1) % WINDOW_CYCLES % SLICE_CYCLES == 0) end_leaf(run);
+            }
+        }
+        else
+        {
+            static int32_t stems[RN_STEM_COUNT][(WINDOW_CYCLES / 24 + 1) * 2];
+            static void *const stem_buffers[RN_STEM_COUNT] = { stems[0], stems[1], stems[2], stems[3], stems[4], stems[5], stems[6] };
+            uint32_t path = run->cycle / WINDOW_CYCLES / 6 % 3;
+            uint32_t stem_count = 0;
+
+            if (path == 1 && !run->taps)
+            {
+                run->taps = RN_TapsBegin(run->chip, 1);
+                if (!run->taps) fail("Failed to start taps", NULL);
+                run->tap_cursor = 0;
+            }
+            else if (path != 1 && run->taps)
+            {
+                RN_TapsEnd(run->chip);
+                run->taps = NULL;
+            }
+
+            if (path == 2) stem_count = RN_ClockStems(run->chip, step, RN_FORMAT_S32, stem_buffers);
+            else RN_Clock(run->chip, step);
+
+            uint32_t count = dequeue_s16(run, buffer, RN_SAMPLE_QUEUE_LENGTH / 2);
+
+            if (run->taps) check_taps(run, buffer, count);
+
+            for (uint32_t i = 0; i < stem_count * 2; i++)
+            {
+                int32_t sum = 0;
+                for (int stem = 0; stem < RN_STEM_COUNT; stem++) sum += stems[stem][i];
+                if (stem_count != count || clamp_s16(sum) != buffer[i]) fail("Stems do not add up to the mix", NULL);
+            }
+            for (uint32_t i = 0; i < count; i++)
+            {
+                hash_value(run, 's', (uint16_t)buffer[i * 2] | ((uint32_t)(uint16_t)buffer[i * 2 + 1] << 16));
+                end_leaf(run);
+            }
+            run->samples += count;
+        }
+
+        run->cycle += step;
+        cycles -= step;
+
+        if (run->cycle % WINDOW_CYCLES == 0) end_window(run);
+    }
+}
+
+static Windows run_script(const Script *script, RN_ChipType chip_type, Stream stream, Run *run)
+{
+    run->chip = RN_Create(chip_type | script->mode);
+    if (!run->chip) fail("Failed to create chip", NULL);
+
+    RN_Reset(run->chip);
+    run->taps = NULL;
+    run->stream = stream;
+    run->cycle = 0;
+    run->hash = 0xcbf29ce484222325ULL;
+    run->leaf_hash = 0xcbf29ce484222325ULL;
+
+    for (size_t i = 0; i < script->count; i++)
+    {
+        const Command *command = &script->commands[i];
+        const uint32_t *args = command->args;
+
+        switch (command->op)
+        {
+            case 'w':
+                RN_Write(run->chip, args[0] * 2, (uint8_t)args[1]);
+                clock_cycles(run, ADDRESS_CLOCKS);
+                RN_Write(run->chip, args[0] * 2 + 1, (uint8_t)args[2]);
+                clock_cycles(run, DATA_CLOCKS);
+                break;
+            case 'p':
+                RN_Write(run->chip, args[0], (uint8_t)args[1]);
+                break;
+            case 'c':
+                clock_cycles(run, args[0]);
+                break;
+            case 'r':
+                hash_value(run, 'r', RN_Read(run->chip, args[0]));
+                break;
+            case 't':
+                RN_SetTestPin(run->chip, args[0]);
+                break;
+            case 'i':
+                hash_value(run, 'i', RN_ReadIRQPin(run->chip) | (RN_ReadTestPin(run->chip) << 1));
+                break;
+        }
+    }
+
+    // Trailing partial window
+    if (run->cycle % WINDOW_CYCLES != 0) end_window(run);
+
+    RN_Destroy(run->chip);
+    return run->windows;
+}
+
+static int generate(const Script *script, const char *script_name, const char *golden_name)
+{
+    const char *slash = strrchr(script_name, '/');
+    if (slash) script_name = slash + 1;
+
+    FILE *f = fopen(golden_name, "w");
+    if (!f) fail("Failed to create golden file: ", golden_name);
+
+    fprintf(f, "# Golden hashes of %s, %d cycle windows followed by their leaves. Regenerate with renuke-golden --generate\n", script_name, WINDOW_CYCLES);
+
+    for (size_t c = 0; c < CHIP_TYPE_COUNT; c++)
+    {
+        for (int s = 0; s < STREAM_COUNT; s++)
+        {
+            if (!(chip_types[c].streams & (1 << s))) continue;
+
+            Run run = {0};
+            Windows windows = run_script(script, chip_types[c].type, (Stream)s, &run);
+
+            for (size_t w = 0; w < windows.count; w++)
+            {
+                fprintf(f, "%s %s %zu %016llx %s\n", chip_types[c].name, stream_names[s], w,
+                    (unsigned long long)windows.windows[w].hash, windows.windows[w].leaves);
+            }
+
+            free(windows.windows);
+        }
+    }
+
+    fclose(f);
+    return 0;
+}
+
+// Narrows a divergent window down to its first divergent leaf
+static void report(size_t c, Stream s, size_t w, const Window *actual, const Window *expected)
+{
+    uint64_t first = (uint64_t)w * WINDOW_CYCLES;
+    uint64_t last = first + WINDOW_CYCLES - 1;
+    size_t leaf;
+
+    for (leaf = 0; actual->leaves[leaf] && actual->leaves[leaf] == expected->leaves[leaf]; leaf++);
+
+    printf("FAIL %s %s: ", chip_types[c].name, stream_names[s]);
+    if (!actual->leaves[leaf] && !expected->leaves[leaf])
+    {
+        // Values hashed after the last leaf of a window only show up in the next window's first leaf
+        printf("all samples match, a read or pin value in cycles %llu-%llu diverged\n", (unsigned long long)first, (unsigned long long)last);
+    }
+    else if (s == STREAM_SAMPLE)
+    {
+        uint64_t sample = actual->first_sample + leaf;
+        printf("first divergence at sample %llu (or a read or pin value before it)\n", (unsigned long long)sample);
+        first = sample * SLICE_CYCLES;
+        last = first + SLICE_CYCLES - 1;
+    }
+    else
+    {
+        first += (uint64_t)leaf * SLICE_CYCLES;
+        if (last > first + SLICE_CYCLES - 1) last = first + SLICE_CYCLES - 1;
+        printf("first divergence in cycles %llu-%llu (or a read or pin value before them)\n", (unsigned long long)first, (unsigned long long)last);
+    }
+
+    printf("     compare renuke-golden --trace %s %llu %llu <script> against a known good build\n",
+        chip_types[c].name, (unsigned long long)first, (unsigned long long)last);
+}
+
+static int compare(const Script *script, const char *golden_name)
+{
+    Windows golden[CHIP_TYPE_COUNT][STREAM_COUNT] = {{{0}}};
+    char line[MAX_LINE];
+    int failures = 0;
+
+    FILE *f = fopen(golden_name, "r");
+    if (!f) fail("Failed to open golden file: ", golden_name);
+
+    while (fgets(line, sizeof(line), f))
+    {
+        char chip[16], stream[16];
+        size_t window;
+        unsigned long long hash;
+        int leaves = 0;
+        size_t c;
+        int s;
+
+        if (line[0] == '#') continue;
+        if (sscanf(line, "%15s %15s %zu %llx %n", chip, stream, &window, &hash, &leaves) != 4 || !leaves) fail("Malformed golden line: ", line);
+
+        size_t leaf_count = strcspn(line + leaves, " \r\n");
+        for (c = 0; c < CHIP_TYPE_COUNT && strcmp(chip, chip_types[c].name) != 0; c++);
+        for (s = 0; s < STREAM_COUNT && strcmp(stream, stream_names[s]) != 0; s++);
+        if (c == CHIP_TYPE_COUNT || s == STREAM_COUNT || !(chip_types[c].streams & (1 << s)) || window != golden[c][s].count || leaf_count > MAX_LEAVES) fail("Malformed golden line: ", line);
+
+        Windows *windows = &golden[c][s];
+        windows->windows = grow(windows->windows, &windows->capacity, windows->count, sizeof(Window));
+        Window *expected = &windows->windows[windows->count++];
+        expected->hash = hash;
+        memcpy(expected->leaves, line + leaves, leaf_count);
+        expected->leaves[leaf_count] = '\0';
+    }
+
+    fclose(f);
+
+    for (size_t c = 0; c < CHIP_TYPE_COUNT; c++)
+    {
+        for (int s = 0; s < STREAM_COUNT; s++)
+        {
+            if (!(chip_types[c].streams & (1 << s))) continue;
+
+            Run run = {0};
+            Windows windows = run_script(script, chip_types[c].type, (Stream)s, &run);
+            Windows *expected = &golden[c][s];
+            size_t count = windows.count < expected->count ? windows.count : expected->count;
+            size_t w;
+
+            for (w = 0; w < count && windows.windows[w].hash == expected->windows[w].hash; w++);
+
+            if (w < count)
+            {
+                report(c, (Stream)s, w, &windows.windows[w], &expected->windows[w]);
+                failures++;
+            }
+            else if (windows.count != expected->count)
+            {
+                printf("FAIL %s %s: %zu windows, golden has %zu\n", chip_types[c].name, stream_names[s], windows.count, expected->count);
+                failures++;
+            }
+            else
+            {
+                printf("ok   %s %s: %zu windows\n", chip_types[c].name, stream_names[s], windows.count);
+            }
+
+            free(windows.windows);
+            free(expected->windows);
+        }
+    }
+
+    return failures ? 1 : 0;
+}
+
+static int trace(const Script *script, const char *chip, uint64_t first, uint64_t last)
+{
+    size_t c;
+    for (c = 0; c < CHIP_TYPE_COUNT && strcmp(chip, chip_types[c].name) != 0; c++);
+    if (c == CHIP_TYPE_COUNT) fail("Unknown chip type: ", chip);
+
+    Run run = {0};
+    run.trace = 1;
+    run.trace_first = first;
+    run.trace_last = last;
+
+    Windows windows = run_script(script, chip_types[c].type, STREAM_CYCLE, &run);
+    free(windows.windows);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    int result;
+
+    if (argc == 3)
+    {
+        Script script = load_script(argv[1]);
+        result = compare(&script, argv[2]);
+        free(script.commands);
+    }
+    else if (argc == 4 && strcmp(argv[1], "--generate") == 0)
+    {
+        Script script = load_script(argv[2]);
+        result = generate(&script, argv[2], argv[3]);
+        free(script.commands);
+    }
+    else if (argc == 6 && strcmp(argv[1], "--trace") == 0)
+    {
+        Script script = load_script(argv[5]);
+        result = trace(&script, argv[2], strtoull(argv[3], NULL, 0), strtoull(argv[4], NULL, 0));
+        free(script.commands);
+    }
+    else
+    {
+        fprintf(stderr, "Usage: %s [--generate] <script> <golden>\n", argv[0]);
+        fprintf(stderr, "       %s --trace <chip> <first cycle> <last cycle> <script>\n", argv[0]);
+        return 1;
+    }
+
+    return result;
+}
@@ -0,0 +1,310 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "renuke.h"
+
+// Output stage checks. Resampler: a tone in the passband comes through at the right phase and amplitude, a tone above
+// the output Nyquist frequency is rejected, the output does not depend on how the input is chunked, and
+// RN_RenderResampled fills its buffer. RN_RenderDecimated must give the same tone as RN_RenderResampled, with
+// the images of the per-cycle output filtered out. Output filter: -3 dB at the corner, DC blocked, and the
+// same result in every format and however the buffer is split. Prints the measured levels.
+
+#define PI 3.14159265358979323846
+#define IN_RATE RN_SAMPLE_RATE_NTSC
+#define IN_SAMPLES 16384
+#define OUT_MAX (IN_SAMPLES * 2)
+#define MIN_REJECTION 50.0 // dB, of a 25 kHz tone, just past the 24 kHz edge at 48 kHz
+
+static const struct
+{
+    const char *name;
+    RN_ResampleQuality quality;
+    double min_snr;       // dB, 1 kHz tone against the ideal output
+} presets[] =
+{
+    { "fast", RN_RESAMPLE_FAST, 65.0 },
+    { "medium", RN_RESAMPLE_MEDIUM, 80.0 },
+    { "best", RN_RESAMPLE_BEST, 95.0 },
+};
+
+static float input[IN_SAMPLES * 2];
+static float output[OUT_MAX * 2];
+static float chunked[OUT_MAX * 2];
+
+static int failures = 0;
+
+static void tone(double frequency)
+{
+    for (int i = 0; i < IN_SAMPLES; i++)
+    {
+        input[i * 2] = (float)(0.5 * sin(2 * PI * frequency * i / IN_RATE));
+        input[i * 2 + 1] = (float)(0.25 * cos(2 * PI * frequency * i / IN_RATE));
+    }
+}
+
+// Resamples the input in one call, or in chunks of varying size, returns the output count
+static uint32_t run(RN_Resampler *resampler, float *out, int chunks)
+{
+    uint32_t consumed = 0, produced = 0;
+
+    RN_ResamplerReset(resampler);
+    for (uint32_t chunk = 1; consumed < IN_SAMPLES; chunk = chunk * 7 % 509 + 1)
+    {
+        uint32_t in_count = chunks ? chunk : IN_SAMPLES;
+        uint32_t out_count = chunks ? chunk % 300 + 1 : OUT_MAX - produced;
+        if (in_count > IN_SAMPLES - consumed) in_count = IN_SAMPLES - consumed;
+        if (out_count > OUT_MAX - produced) out_count = OUT_MAX - produced;
+
+        RN_ResamplerProcess(resampler, RN_FORMAT_F32, input + consumed * 2, &in_count, out + produced * 2, &out_count);
+        consumed += in_count;
+        produced += out_count;
+    }
+
+    // Drain what the last input allows
+    uint32_t in_count = 0, out_count = OUT_MAX - produced;
+    RN_ResamplerProcess(resampler, RN_FORMAT_F32, NULL, &in_count, out + produced * 2, &out_count);
+    return produced + out_count;
+}
+
+static double decibels(double ratio)
+{
+    return 20.0 * log10(ratio > 1e-12 ? ratio : 1e-12);
+}
+
+static void check_preset(int p, double out_rate)
+{
+    RN_Resampler *resampler = RN_ResamplerCreate(IN_RATE, out_rate, presets[p].quality);
+    if (!resampler)
+    {
+        fprintf(stderr, "resample %s: create failed\n", presets[p].name);
+        failures++;
+        return;
+    }
+
+    // Passband tone, away from the start and end where the filter sees silence
+    tone(1000.0);
+    uint32_t count = run(resampler, output, 0);
+    double signal = 0.0, error = 0.0;
+    for (uint32_t i = 200; i + 200 < count; i++)
+    {
+        double t = i * IN_RATE / out_rate;
+        double expected[2] = { 0.5 * sin(2 * PI * 1000.0 * t / IN_RATE), 0.25 * cos(2 * PI * 1000.0 * t / IN_RATE) };
+        for (int c = 0; c < 2; c++)
+        {
+            signal += expected[c] * expected[c];
+            error += (output[i * 2 + c] - expected[c]) * (output[i * 2 + c] - expected[c]);
+        }
+    }
+    double snr = -decibels(sqrt(error / signal));
+
+    uint32_t chunked_count = run(resampler, chunked, 1);
+    if (chunked_count != count || memcmp(output, chunked, count * 2 * sizeof(float)) != 0)
+    {
+        fprintf(stderr, "resample %s: chunked output differs\n", presets[p].name);
+        failures++;
+    }
+
+    // Stopband tone, only checked where the transition band ends below it
+    double alias = -INFINITY;
+    if (out_rate < 50000)
+    {
+        tone(25000.0);
+        count = run(resampler, output, 0);
+        double level = 0.0;
+        for (uint32_t i = 200; i + 200 < count; i++) level += output[i * 2] * output[i * 2];
+        alias = decibels(sqrt(level / (count - 400)) / (0.5 / sqrt(2.0)));
+    }
+
+    printf("%-6s %5.0f Hz: %u samples, 1 kHz SNR %.1f dB, 25 kHz %.1f dB\n", presets[p].name, out_rate, count, snr, alias);
+    if (snr < presets[p].min_snr || alias > -MIN_REJECTION)
+    {
+        fprintf(stderr, "resample %s: out of spec\n", presets[p].name);
+        failures++;
+    }
+
+    RN_ResamplerDestroy(resampler);
+}
+
+static void write_register(RN_Chip *chip, uint32_t part, uint8_t reg, uint8_t data)
+{
+    RN_ScheduleWrite(chip, part, reg);
+    RN_ScheduleWrite(chip, part + 1, data);
+}
+
+// Channel 1 as a ~1 kHz sine from operator 4 alone, which the chip outputs on 4 of every 24 cycles
+static RN_Chip *sine_chip(void)
+{
+    RN_Chip *chip = RN_Create(0);
+    write_register(chip, 0, RN_FEED_ALG, 0x07);
+    write_register(chip, 0, RN_ST_LFOSEN, 0xC0);
+    for (uint8_t op = 0; op < 4; op++)
+    {
+        write_register(chip, 0, RN_DT_MUL + op * 4, 0x01);
+        write_register(chip, 0, RN_TOT_LEVEL + op * 4, op == 3 ? 0x00 : 0x7F);
+        write_register(chip, 0, RN_RS_AR + op * 4, 0x1F);
+        write_register(chip, 0, RN_D1L_RR + op * 4, 0x0F);
+    }
+    write_register(chip, 0, RN_FREQ_BLOCK_MSB, 0x2C); // Block 5, fnum 1230
+    write_register(chip, 0, RN_FREQ_LSB, 0xCE);
+    write_register(chip, 0, RN_KEYONOFF, 0xF0);
+    return chip;
+}
+
+// Residual after the best fit of a sine near frequency, relative to it, and its level
+static double sine_residual(const float *samples, int count, double rate, double frequency, double *level)
+{
+    double best = 1e300, best_signal = 0.0;
+
+    for (double f = frequency - 1.0; f <= frequency + 1.0; f += 0.005)
+    {
+        double ss = 0, sc = 0, cc = 0, xs = 0, xc = 0, energy = 0;
+        for (int i = 0; i < count; i++)
+        {
+            double s = sin(2 * PI * f * i / rate), c = cos(2 * PI * f * i / rate), x = samples[i * 2];
+            ss += s * s; sc += s * c; cc += c * c; xs += x * s; xc += x * c; energy += x * x;
+        }
+        double det = ss * cc - sc * sc;
+        double a = (xs * cc - xc * sc) / det, b = (xc * ss - xs * sc) / det;
+        double fitted = a * xs + b * xc;
+        if (energy - fitted < best)
+        {
+            best = energy - fitted;
+            best_signal = fitted;
+        }
+    }
+
+    *level = decibels(sqrt(best_signal / count * 2));
+    return decibels(sqrt(best / best_signal));
+}
+
+static void check_decimator(void)
+{
+    static float resampled[9600 * 2], decimated[9600 * 2], whole[9600 * 2];
+    RN_Chip *reference = sine_chip(), *chip = sine_chip();
+    RN_Resampler *resampler = RN_ResamplerCreate(RN_MASTER_CLOCK_NTSC / 1008.0, 48000.0, RN_RESAMPLE_BEST);
+    RN_Decimator *decimator = RN_DecimatorCreate(RN_MASTER_CLOCK_NTSC / 1008.0, 48000.0, RN_RESAMPLE_BEST);
+
+    RN_RenderResampled(reference, resampler, RN_FORMAT_F32, resampled, 9600);
+    RN_RenderDecimated(chip, decimator, RN_FORMAT_F32, decimated, 4000);
+    RN_RenderDecimated(chip, decimator, RN_FORMAT_F32, decimated + 8000, 5600);
+
+    RN_Destroy(chip);
+    chip = sine_chip();
+    RN_DecimatorReset(decimator);
+    RN_RenderDecimated(chip, decimator, RN_FORMAT_F32, whole, 9600);
+    if (memcmp(whole, decimated, sizeof(whole)) != 0)
+    {
+        fprintf(stderr, "decimator: split rendering differs\n");
+        failures++;
+    }
+
+    // Past the attack both hold the same steady tone. The decimator keeps channel 1 on its own cycles of each
+    // sample, so its timing is a few cycles off the queue's, but images of the per-cycle output that got
+    // through would raise what is left after the sine.
+    double frequency = 1230 * 16 * (RN_MASTER_CLOCK_NTSC / 1008.0) / 1048576;
+    double resampled_level, decimated_level;
+    double resampled_residual = sine_residual(resampled + 4800 * 2, 4800, 48000.0, frequency, &resampled_level);
+    double decimated_residual = sine_residual(decimated + 4800 * 2, 4800, 48000.0, frequency, &decimated_level);
+
+    printf("decimator 48000 Hz: tone %.2f dBFS, residual %.1f dB, %.2f dBFS and %.1f dB through RN_RenderResampled\n",
+        decimated_level, decimated_residual, resampled_level, resampled_residual);
+    if (fabs(decimated_level - resampled_level) > 0.05 || decimated_residual > resampled_residual + 1.0 ||
+        RN_GetQueuedSamplesCount(chip) != 0)
+    {
+        fprintf(stderr, "decimator: out of spec\n");
+        failures++;
+    }
+
+    RN_DecimatorDestroy(decimator);
+    RN_ResamplerDestroy(resampler);
+    RN_Destroy(chip);
+    RN_Destroy(reference);
+}
+
+static void check_output_filter(void)
+{
+    static float interleaved[IN_SAMPLES * 2], left[IN_SAMPLES], right[IN_SAMPLES];
+    static int16_t s16[IN_SAMPLES * 2];
+    RN_OutputFilter *filter = RN_OutputFilterCreate(RN_MODEL_MD1, IN_RATE);
+
+    // 3390 Hz corner, the left channel's level over the second half against its 0.5 amplitude
+    tone(3390.0);
+    memcpy(interleaved, input, sizeof(interleaved));
+    RN_OutputFilterProcess(filter, RN_FORMAT_F32, interleaved, NULL, IN_SAMPLES);
+    double level = 0.0;
+    for (int i = IN_SAMPLES / 2; i < IN_SAMPLES; i++) level += interleaved[i * 2] * interleaved[i * 2];
+    double corner = decibels(sqrt(level / (IN_SAMPLES / 2)) / (0.5 / sqrt(2.0)));
+
+    // The same tone planar, in odd sized pieces, and as int16
+    RN_OutputFilterReset(filter);
+    for (int i = 0; i < IN_SAMPLES; i++)
+    {
+        left[i] = input[i * 2];
+        right[i] = input[i * 2 + 1];
+        s16[i * 2] = (int16_t)lrintf(input[i * 2] * 32767.0f);
+        s16[i * 2 + 1] = (int16_t)lrintf(input[i * 2 + 1] * 32767.0f);
+    }
+    for (uint32_t offset = 0, count = 1; offset < IN_SAMPLES; offset += count, count = count * 3 % 1021 + 1)
+    {
+        if (count > IN_SAMPLES - offset) count = IN_SAMPLES - offset;
+        RN_OutputFilterProcess(filter, RN_FORMAT_F32 | RN_FORMAT_PLANAR, left + offset, right + offset, count);
+    }
+    RN_OutputFilterReset(filter);
+    RN_OutputFilterProcess(filter, RN_FORMAT_S16, s16, NULL, IN_SAMPLES);
+
+    int mismatches = 0;
+    for (int i = 0; i < IN_SAMPLES; i++)
+    {
+        if (left[i] != interleaved[i * 2] || right[i] != interleaved[i * 2 + 1]) mismatches++;
+        if (fabs(s16[i * 2] - interleaved[i * 2] * 32767.0) > 1.5) mismatches++;
+    }
+
+    // A constant decays through the DC block
+    RN_OutputFilterReset(filter);
+    for (int pass = 0; pass < 4; pass++)
+    {
+        for (int i = 0; i < IN_SAMPLES * 2; i++) interleaved[i] = 0.25f;
+        RN_OutputFilterProcess(filter, RN_FORMAT_F32, interleaved, NULL, IN_SAMPLES);
+    }
+    double dc = fabs(interleaved[IN_SAMPLES * 2 - 1]);
+
+    printf("output filter md1: %.2f dB at 3390 Hz, DC %.1e after 1.2 s, %d mismatches\n", corner, dc, mismatches);
+    if (fabs(corner + 3.01) > 0.05 || dc > 1e-6 || mismatches)
+    {
+        fprintf(stderr, "output filter: out of spec\n");
+        failures++;
+    }
+
+    RN_OutputFilterDestroy(filter);
+}
+
+int main(void)
+{
+    for (int p = 0; p < (int)(sizeof(presets) / sizeof(presets[0])); p++)
+    {
+        check_preset(p, 48000.0);
+        check_preset(p, 44100.0);
+        check_preset(p, 96000.0);
+    }
+
+    // A chip rendered straight to 48 kHz
+    RN_Chip *chip = RN_Create(RNCM_YM2612);
+    RN_Resampler *resampler = RN_ResamplerCreate(IN_RATE, 48000.0, RN_RESAMPLE_MEDIUM);
+    static int16_t rendered[48000 * 2];
+    memset(rendered, 0x55, sizeof(rendered));
+    RN_RenderResampled(chip, resampler, RN_FORMAT_S16, rendered, 1000);
+    RN_RenderResampled(chip, resampler, RN_FORMAT_S16, rendered + 2000, 47000);
+    if (rendered[95999] == 0x5555)
+    {
+        fprintf(stderr, "resample: RN_RenderResampled left samples unwritten\n");
+        failures++;
+    }
+    RN_ResamplerDestroy(resampler);
+    RN_Destroy(chip);
+
+    check_decimator();
+    check_output_filter();
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "renuke.h"
+
+// Write trace round trip. Records a run that goes through every traced entry point, replays it with
+// RN_TraceReplay and checks that the replay dequeues the same samples and reads the same values.
+//
+// Usage: renuke-trace <trace file>
+
+typedef struct
+{
+    uint64_t samples;
+    uint64_t hash;
+} Output;
+
+// FNV-1a, 64 bit
+static void hash_samples(void *userdata, const int16_t *samples, uint32_t sample_count)
+{
+    Output *output = userdata;
+
+    for (uint32_t i = 0; i < sample_count * 2; i++)
+    {
+        output->hash = (output->hash ^ (uint16_t)samples[i]) * 0x100000001b3ULL;
+    }
+
+    output->samples += sample_count;
+}
+
+static void dequeue(RN_Chip *chip, Output *output, uint32_t sample_count)
+{
+    int16_t buffer[RN_SAMPLE_QUEUE_LENGTH];
+    uint32_t count = RN_DequeueSamples(chip, buffer, sample_count);
+    hash_samples(output, buffer, count);
+}
+
+static void write_register(RN_Chip *chip, uint32_t part, uint8_t reg, uint8_t data)
+{
+    RN_Write(chip, part * 2, reg);
+    RN_Clock(chip, 12);
+    RN_Write(chip, part * 2 + 1, data);
+    RN_Clock(chip, 36);
+}
+
+// A two operator tone on channel 1 and timer A, with LFO on
+static void setup(RN_Chip *chip)
+{
+    write_register(chip, 0, 0x22, 0x0B);
+    write_register(chip, 0, 0xB0, 0x04);
+    write_register(chip, 0, 0xB4, 0xF7);
+    write_register(chip, 0, 0x30, 0x01);
+    write_register(chip, 0, 0x34, 0x02);
+    write_register(chip, 0, 0x40, 0x10);
+    write_register(chip, 0, 0x44, 0x7F);
+    write_register(chip, 0, 0x4C, 0x00);
+    write_register(chip, 0, 0x50, 0x1F);
+    write_register(chip, 0, 0x5C, 0x1F);
+    write_register(chip, 0, 0x80, 0x0F);
+    write_register(chip, 0, 0x8C, 0x0F);
+    write_register(chip, 0, 0xA4, 0x22);
+    write_register(chip, 0, 0xA0, 0x69);
+    write_register(chip, 0, 0x24, 0xF0);
+    write_register(chip, 0, 0x27, 0x15);
+    write_register(chip, 0, 0x28, 0xF0);
+}
+
+static void record(RN_Chip *chip, RN_Decimator *decimator, Output *output)
+{
+    int16_t buffer[2];
+    int16_t decimated[64 * 2];
+
+    for (int i = 0; i < 64; i++)
+    {
+        // Uneven clock counts, RN_Clock1 runs and partial dequeues
+        RN_Clock(chip, 200 + i * 37);
+        for (int j = 0; j < i % 5; j++) RN_Clock1(chip, buffer);
+        dequeue(chip, output, 3 + i % 17);
+
+        // Scheduled writes sweep the pitch, plain writes retrigger the key
+        RN_ScheduleWrite(chip, 0, 0xA4);
+        RN_ScheduleWrite(chip, 1, (uint8_t)(0x20 | (i & 7)));
+        RN_ScheduleWrite(chip, 0, 0xA0);
+        RN_ScheduleWrite(chip, 1, (uint8_t)(i * 11));
+        if (i % 8 == 7)
+        {
+            write_register(chip, 0, 0x28, 0x00);
+            write_register(chip, 0, 0x28, 0xF0);
+        }
+
+        RN_Read(chip, 0);
+        // RN_RenderDecimated clocks without the sample queue, the replay has to do the same
+        if (i % 4 == 2) RN_RenderDecimated(chip, decimator, RN_FORMAT_S16, decimated, 17 + i % 32);
+        if (i % 16 == 5) RN_SetTestPin(chip, 1);
+        if (i % 16 == 9) RN_SetTestPin(chip, 0);
+        if (i == 40) RN_Reset(chip);
+        if (i == 41) write_register(chip, 0, 0x28, 0xF0);
+    }
+
+    RN_Clock(chip, 4000);
+    dequeue(chip, output, RN_SAMPLE_QUEUE_LENGTH / 2);
+}
+
+static int round_trip(const char *path, RN_ChipType chip_type, uint32_t flags)
+{
+    Output recorded = { 0, 0xcbf29ce484222325ULL };
+    Output replayed = { 0, 0xcbf29ce484222325ULL };
+
+    RN_Chip *chip = RN_Create(chip_type);
+    RN_Decimator *decimator = RN_DecimatorCreate(RN_SAMPLE_RATE_NTSC, 48000.0, RN_RESAMPLE_FAST);
+    if (!chip || !decimator)
+    {
+        fprintf(stderr, "Failed to create chip\n");
+        return 1;
+    }
+
+    // Start recording mid-note with a frequency write still in flight, so the replay depends on the snapshot
+    RN_Reset(chip);
+    setup(chip);
+    RN_Clock(chip, 1000);
+    RN_Write(chip, 0, 0xA0);
+    RN_Clock(chip, 12);
+    RN_Write(chip, 1, 0x40);
+
+    if (RN_TraceBegin(chip, path, flags) != 0)
+    {
+        fprintf(stderr, "Failed to begin trace %s\n", path);
+        RN_Destroy(chip);
+        RN_DecimatorDestroy(decimator);
+        return 1;
+    }
+
+    record(chip, decimator, &recorded);
+
+    if (RN_TraceEnd(chip) != 0)
+    {
+        fprintf(stderr, "Failed to end trace %s\n", path);
+        RN_Destroy(chip);
+        RN_DecimatorDestroy(decimator);
+        return 1;
+    }
+    RN_Destroy(chip);
+    RN_DecimatorDestroy(decimator);
+
+    int mismatches = RN_TraceReplay(path, hash_samples, &replayed);
+    remove(path);
+
+    if (mismatches != 0 || replayed.samples != recorded.samples || replayed.hash != recorded.hash)
+    {
+        printf("FAIL chip type %u flags %u: %llu samples (hash %016llx), replay %llu samples (hash %016llx), %d read mismatches\n",
+            (unsigned)chip_type, flags, (unsigned long long)recorded.samples, (unsigned long long)recorded.hash,
+            (unsigned long long)replayed.samples, (unsigned long long)replayed.hash, mismatches);
+        return 1;
+    }
+
+    printf("ok   chip type %u flags %u: %llu samples\n", (unsigned)chip_type, flags, (unsigned long long)recorded.samples);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: %s <trace file>\n", argv[0]);
+        return 1;
+    }
+
+    // RN_TRACE_MMAP falls back to the buffered writer where mmap is not available
+    int failures = round_trip(argv[1], RNCM_YM2612, 0);
+    failures += round_trip(argv[1], RNCM_YM2612, RN_TRACE_MMAP);
+    // The fast engine restores its caches from the snapshot
+    failures += round_trip(argv[1], RNCM_YM2612 | RNCM_FAST, 0);
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,230 @@
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+#include "renuke.hpp"
+
+// Checks renuke.hpp against the C API: the same writes rendered through renuke::Chip and through
+// RN_ScheduleWrite/RN_Clock/RN_DequeueSamples must give identical samples.
+
+#define SAMPLES 4096
+
+static_assert(!std::is_copy_constructible<renuke::YM2612>::value, "chips are move-only");
+static_assert(std::is_nothrow_move_constructible<renuke::YM2612>::value, "chips move without throwing");
+static_assert(std::is_nothrow_move_assignable<renuke::YM3438>::value, "chips move without throwing");
+static_assert(renuke::Chip<renuke::Model::YM2612, renuke::Fast>::type == (RNCM_YM2612 | RNCM_FAST), "chip type");
+
+#ifdef RENUKE_HAVE_PMR
+static_assert(!std::is_copy_constructible<renuke::ChipPool<renuke::Model::YM2612>::Handle>::value, "handles are move-only");
+#endif
+
+static int failures = 0;
+
+static void check(bool condition, const char *what)
+{
+    if (!condition)
+    {
+        std::fprintf(stderr, "renuke-wrapper: %s\n", what);
+        failures++;
+    }
+}
+
+// A sustained note on channel 1 with a fast attack
+static std::vector<renuke::RegisterWrite> note()
+{
+    std::vector<renuke::RegisterWrite> writes = { { 0, RN_FEED_ALG, 0x32 }, { 0, RN_ST_LFOSEN, 0xC0 } };
+    for (uint8_t op = 0; op < 4; op++)
+    {
+        writes.push_back({ 0, (uint8_t)(RN_DT_MUL + op * 4), (uint8_t)(0x01 + op) });
+        writes.push_back({ 0, (uint8_t)(RN_TOT_LEVEL + op * 4), (uint8_t)(op == 3 ? 0x08 : 0x20) });
+        writes.push_back({ 0, (uint8_t)(RN_RS_AR + op * 4), 0x1F });
+        writes.push_back({ 0, (uint8_t)(RN_D1L_RR + op * 4), 0x0F });
+    }
+    writes.push_back({ 0, RN_FREQ_BLOCK_MSB, 0x22 });
+    writes.push_back({ 0, RN_FREQ_LSB, 0x69 });
+    writes.push_back({ 0, RN_KEYONOFF, 0xF0 });
+    return writes;
+}
+
+template <typename ChipType>
+static void compare_with_c_api(const char *name)
+{
+    std::vector<renuke::RegisterWrite> writes = note();
+    std::vector<int16_t> expected(SAMPLES * 2), rendered(SAMPLES * 2);
+
+    RN_Chip *reference = RN_Create(ChipType::type);
+    for (const renuke::RegisterWrite &write : writes)
+    {
+        RN_ScheduleWrite(reference, write.part ? 2 : 0, write.address);
+        RN_ScheduleWrite(reference, write.part ? 3 : 1, write.data);
+    }
+    for (size_t done = 0; done < SAMPLES; done += RN_DequeueSamples(reference, &expected[done * 2], SAMPLES - done))
+    {
+        RN_Clock(reference, 256 * 24);
+    }
+    RN_Destroy(reference);
+
+    ChipType chip;
+    chip.schedule(writes);
+
+    // Moving hands the chip over mid-render
+    size_t done = chip.render(rendered.data(), 1000);
+    ChipType moved(std::move(chip));
+    check(chip.get() == nullptr, "moved-from chip still owns its RN_Chip");
+#ifdef RENUKE_HAVE_SPAN
+    done += moved.render(std::span<int16_t>(rendered).subspan(done * 2));
+#else
+    done += moved.render(rendered.data() + done * 2, SAMPLES - done);
+#endif
+
+    check(done == SAMPLES, "render returned a short count");
+    if (std::memcmp(expected.data(), rendered.data(), expected.size() * sizeof(int16_t)) != 0)
+    {
+        std::fprintf(stderr, "renuke-wrapper: %s output differs from the C API\n", name);
+        failures++;
+    }
+}
+
+// A note on channel 1 of a YM3438 only comes out of stem 0, and the stems add up to the mix
+template <typename ChipType>
+static void compare_stems(const char *name)
+{
+    static int32_t stems[RN_STEM_COUNT][(SAMPLES / 8 + 1) * 2];
+    int32_t *const buffers[RN_STEM_COUNT] = { stems[0], stems[1], stems[2], stems[3], stems[4], stems[5], stems[6] };
+    std::vector<int32_t> mix(SAMPLES / 8 * 2);
+
+    ChipType chip;
+    chip.schedule(note());
+    chip.clock(64 * 24); // Lets the note start
+    chip.dequeue(mix.data(), chip.queued());
+
+    size_t count = chip.clock_stems(SAMPLES / 8 * 24, buffers);
+    check(count == SAMPLES / 8 && chip.dequeue(mix.data(), count) == count, "stem sample count");
+
+    bool sums = true, silent = true, sound = false;
+    for (size_t i = 0; i < count * 2; i++)
+    {
+        int32_t sum = 0;
+        for (int stem = 0; stem < RN_STEM_COUNT; stem++)
+        {
+            sum += stems[stem][i];
+            if (stem > 0 && stems[stem][i] != 0) silent = false;
+        }
+        if (sum != mix[i]) sums = false;
+        if (stems[0][i] != 0) sound = true;
+    }
+
+    if (!sums || !silent || !sound) std::fprintf(stderr, "renuke-wrapper: %s stems are wrong\n", name);
+    failures += !sums || !silent || !sound;
+}
+
+#ifdef RENUKE_HAVE_PMR
+// Counts the blocks the pool takes from its upstream resource
+class CountingResource : public std::pmr::memory_resource
+{
+public:
+    size_t allocations = 0;
+
+private:
+    void *do_allocate(size_t bytes, size_t alignment) override
+    {
+        allocations++;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void *p, size_t bytes, size_t alignment) override
+    {
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+        return this == &other;
+    }
+};
+
+// Recycled pool chips, with small queues, render like fresh chips
+static void compare_pool()
+{
+    std::vector<renuke::RegisterWrite> writes = note();
+    std::vector<int16_t> expected(SAMPLES * 2), rendered(SAMPLES * 2);
+
+    renuke::YM2612 fresh;
+    fresh.schedule(writes);
+    fresh.render(expected.data(), SAMPLES);
+
+    CountingResource resource;
+    {
+        renuke::ChipPool<renuke::Model::YM2612> pool(&resource, 64, 64);
+        pool.reserve(2);
+        size_t reserved = resource.allocations;
+
+        for (int round = 0; round < 100; round++)
+        {
+            auto first = pool.acquire();
+            auto second = pool.acquire();
+            second.schedule(writes);
+            second.render(rendered.data(), round == 99 ? SAMPLES : 100);
+            first = std::move(second);
+        }
+
+        check(resource.allocations == reserved, "recycling chips allocated memory");
+        check(pool.allocated() == 2 && pool.available() == 2, "pool lost chips");
+    }
+
+    if (std::memcmp(expected.data(), rendered.data(), expected.size() * sizeof(int16_t)) != 0)
+    {
+        std::fprintf(stderr, "renuke-wrapper: pooled chip output differs\n");
+        failures++;
+    }
+}
+#endif
+
+int main()
+{
+    compare_with_c_api<renuke::YM2612>("ym2612");
+    compare_with_c_api<renuke::YM3438>("ym3438");
+    compare_with_c_api<renuke::Chip<renuke::Model::YM2612, renuke::Fast>>("ym2612-fast");
+    compare_stems<renuke::YM3438>("ym3438");
+    compare_stems<renuke::Chip<renuke::Model::YM3438, renuke::Fast>>("ym3438-fast");
+
+    // Float output matches the int16 output where it does not clip
+    renuke::YM2612 as_int16, as_float;
+    std::vector<int16_t> int16_samples(SAMPLES * 2);
+    std::vector<float> left(SAMPLES), right(SAMPLES);
+    as_int16.schedule(note());
+    as_float.schedule(note());
+    as_int16.render(int16_samples.data(), SAMPLES);
+    for (size_t done = 0; done < SAMPLES; done += 256)
+    {
+        as_float.clock(256 * 24);
+        check(as_float.dequeue(&left[done], &right[done], 256) == 256, "planar float dequeue returned a short count");
+    }
+    for (size_t i = 0; i < SAMPLES * 2; i++)
+    {
+        float value = (i % 2 ? right : left)[i / 2] * 32768.0f;
+        int16_t expected_value = int16_samples[i];
+        if (value > 32767.0f || value < -32768.0f)
+        {
+            check(expected_value == (value > 0 ? 32767 : -32768), "int16 output did not clamp");
+        }
+        else if (value != expected_value)
+        {
+            check(false, "planar float output differs from int16");
+            break;
+        }
+    }
+
+    // Port level batches and reads
+    renuke::YM3438 chip;
+    const renuke::Write timer[] = { { 0, 0x24 }, { 1, 0xFF }, { 0, 0x25 }, { 1, 0x03 }, { 0, RN_TIMERS_CH36 }, { 1, 0x05 } };
+    chip.schedule(timer);
+    chip.clock(24 * 64);
+    check((chip.read(0) & 0x01) != 0, "timer A did not overflow");
+
+#ifdef RENUKE_HAVE_PMR
+    compare_pool();
+#endif
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,118 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "renuke.h"
+
+// Replays a trace recorded with RN_TraceBegin and reports what the run produced.
+// Usage: renuke-replay [-w output.wav] <trace>
+
+typedef struct
+{
+    uint64_t samples;
+    uint32_t hash;
+    FILE *wav;
+} Output;
+
+static void write_le(FILE *f, size_t size, uint64_t value)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        fputc((value >> (i * 8)) & 0xFF, f);
+    }
+}
+
+static void write_wav_header(FILE *f, uint32_t sample_count)
+{
+    fwrite("RIFF", 1, 4, f);
+    write_le(f, 4, 36 + sample_count * 4);
+    fwrite("WAVE", 1, 4, f);
+    fwrite("fmt ", 1, 4, f);
+    write_le(f, 4, 16);
+    write_le(f, 2, 1);                        // PCM
+    write_le(f, 2, 2);                        // Stereo
+    write_le(f, 4, RN_SAMPLE_RATE_NTSC);
+    write_le(f, 4, RN_SAMPLE_RATE_NTSC * 4);
+    write_le(f, 2, 4);
+    write_le(f, 2, 16);
+    fwrite("data", 1, 4, f);
+    write_le(f, 4, sample_count * 4);
+}
+
+static void on_samples(void *userdata, const int16_t *samples, uint32_t sample_count)
+{
+    Output *output = userdata;
+
+    for (uint32_t i = 0; i < sample_count * 2; i++)
+    {
+        // FNV-1a over the dequeued samples, to compare runs
+        output->hash = (output->hash ^ (uint16_t)samples[i]) * 16777619u;
+        if (output->wav) write_le(output->wav, 2, (uint16_t)samples[i]);
+    }
+
+    output->samples += sample_count;
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[])
+{
+    Output output = { 0, 2166136261u, NULL };
+    const char *wav_name = NULL;
+
+    if (argc == 4 && strcmp(argv[1], "-w") == 0)
+    {
+        wav_name = argv[2];
+        argv += 2;
+        argc -= 2;
+    }
+
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: %s [-w output.wav] <trace>\n", argv[0]);
+        return 1;
+    }
+
+    if (wav_name)
+    {
+        output.wav = fopen(wav_name, "wb");
+        if (!output.wav)
+        {
+            fprintf(stderr, "Failed to create %s\n", wav_name);
+            return 1;
+        }
+        write_wav_header(output.wav, 0);
+    }
+
+    double start = now_seconds();
+    int mismatches = RN_TraceReplay(argv[1], on_samples, &output);
+    double elapsed = now_seconds() - start;
+
+    if (output.wav)
+    {
+        // Patch the sizes now that the sample count is known
+        fseek(output.wav, 0, SEEK_SET);
+        write_wav_header(output.wav, (uint32_t)output.samples);
+        fclose(output.wav);
+    }
+
+    if (mismatches < 0)
+    {
+        fprintf(stderr, "Failed to replay %s\n", argv[1]);
+        return 1;
+    }
+
+    printf("Samples dequeued: %llu (hash %08x)\n", (unsigned long long)output.samples, output.hash);
+    printf("Read mismatches: %d\n", mismatches);
+    printf("Replay time: %.3f s\n", elapsed);
+
+    return mismatches ? 2 : 0;
+}